@@ -0,0 +1,77 @@
+// Heap bytes per book held as Book against CompactBook (plus its StringPool),
+// for books shaped like a real catalog: a few hundred authors, a century of
+// years, and two or three tags out of a small vocabulary each.
+//
+//   bench_book_memory [books]    (default 200000)
+#include "bench_common.h"
+#include "lms/CompactBook.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+using namespace lms;
+
+static std::atomic<size_t> requested{0};
+
+void* operator new(size_t size) {
+    requested += size;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+    // Bytes the allocator has handed out, including its per-block overhead;
+    // falls back to the bytes requested where glibc's counters are unavailable
+    size_t heapInUse() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+        struct mallinfo2 info = mallinfo2();
+        return info.uordblks + info.hblkhd;
+#else
+        return requested.load();
+#endif
+    }
+
+    template <typename Fn>
+    void measure(const char* name, size_t count, Fn build) {
+        size_t heapBefore = heapInUse(), requestedBefore = requested.load();
+        build();
+        double heap = static_cast<double>(heapInUse() - heapBefore) / count;
+        double asked = static_cast<double>(requested.load() - requestedBefore) / count;
+        std::printf("%-28s %10.1f %12.1f\n", name, heap, asked);
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    const char* vocabulary[] = {"fiction", "history", "science", "fantasy", "classic", "poetry",
+                                "biography", "mystery", "romance", "horror", "young-adult", "travel"};
+    std::vector<Book> source;
+    source.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        Book book("The Collected Works, Volume " + std::to_string(i), "Author " + std::to_string(i % 500),
+                  std::to_string(1900 + i % 120));
+        for (size_t t = 0; t < 2 + i % 2; ++t) book.addTag(vocabulary[(i * 7 + t * 5) % 12]);
+        book.setID(BookId::timeOrdered());
+        source.push_back(std::move(book));
+    }
+
+    std::printf("%zu books\n%-28s %10s %12s\n", count, "layout", "heap B/book", "new B/book");
+    std::vector<Book> books;
+    measure("Book", count, [&] { books.assign(source.begin(), source.end()); });
+    StringPool pool;
+    std::vector<CompactBook> compact;
+    measure("CompactBook + StringPool", count, [&] {
+        compact.reserve(count);
+        for (const Book& book : source) compact.emplace_back(book, pool);
+    });
+    std::printf("StringPool: %zu strings, %zu bytes\n", pool.size(), pool.memoryUsage());
+    bench::consume(books);
+    bench::consume(compact);
+    return 0;
+}
@@ -0,0 +1,39 @@
+#pragma once
+// Small helpers shared by the benchmarks in this directory
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+namespace bench {
+    // A database path in the temp directory, with any leftovers of an earlier run removed
+    inline std::string freshDatabase(const std::string& name) {
+        std::string path = (std::filesystem::temp_directory_path() / name).string();
+        for (const char* suffix : {"", "-wal", "-shm"}) std::filesystem::remove(path + suffix);
+        return path;
+    }
+
+    inline void removeDatabase(const std::string& path) {
+        for (const char* suffix : {"", "-wal", "-shm"}) std::filesystem::remove(path + suffix);
+    }
+
+    // Best wall-clock time of fn over repetitions runs, in milliseconds
+    template <typename Fn>
+    double bestOf(int repetitions, Fn fn) {
+        double best = 0;
+        for (int i = 0; i < repetitions; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (i == 0 || ms < best) best = ms;
+        }
+        return best;
+    }
+
+    // Keeps the optimizer from discarding a result
+    inline const void* volatile sink = nullptr;
+    template <typename T>
+    inline void consume(const T& value) {
+        sink = &value;
+    }
+}
@@ -0,0 +1,48 @@
+// Insert throughput and file size with content-hash and time-ordered user IDs.
+// Hash keys land at random places in the primary key's B-tree; time-ordered keys
+// append at its right edge (the content_hash index stays random either way).
+//
+//   bench_id_inserts [users]     (default 1000000)
+#include "bench_common.h"
+#include "lms/Database.h"
+#include <cstdlib>
+#include <vector>
+
+using namespace lms;
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    std::vector<User> users;
+    users.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+        users.emplace_back("User " + std::to_string(i), "user" + std::to_string(i) + "@example.com",
+                           std::to_string(1950 + i % 50) + "-01-01", std::to_string(i) + " Main Street");
+
+    std::printf("%zu users\n%-14s %10s %12s %10s\n", count, "ids", "seconds", "users/s", "file MB");
+    const std::pair<const char*, IdStrategy> strategies[] = {
+        {"content hash", IdStrategy::ContentHash},
+        {"time ordered", IdStrategy::TimeOrdered},
+    };
+    for (const auto& [name, strategy] : strategies) {
+        // generateIDs only fills empty IDs, so drop the previous strategy's first
+        for (User& user : users) user.setUserID("");
+        User::generateIDs(users, strategy);
+        std::string path = bench::freshDatabase("lms_bench_id_inserts.db");
+        Database db(path);
+        if (!db.connect()) return 1;
+        size_t failed = 0;
+        double ms = bench::bestOf(1, [&] {
+            // Transactions of 5000 rows, as the Importer uses
+            for (bool ok : db.addUsers(users, 5000)) failed += !ok;
+        });
+        db.disconnect();    // Without a reader pool there is no WAL, so the file is complete
+        if (failed) {
+            std::fprintf(stderr, "%s: %zu inserts failed\n", name, failed);
+            return 1;
+        }
+        double megabytes = static_cast<double>(std::filesystem::file_size(path)) / (1 << 20);
+        std::printf("%-14s %10.2f %12.0f %10.1f\n", name, ms / 1000, count / (ms / 1000), megabytes);
+        bench::removeDatabase(path);
+    }
+    return 0;
+}
@@ -0,0 +1,80 @@
+// Compares the indexed lookups (findBooksByAuthor, findBooksByYearRange,
+// findBooksBorrowedBy) with what callers did before them: getAllBooks() and a
+// filter in C++.
+//
+//   bench_lookups [books]        (default 100000)
+#include "bench_common.h"
+#include "lms/Database.h"
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+using namespace lms;
+
+int main(int argc, char** argv) {
+    size_t bookCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    std::string path = bench::freshDatabase("lms_bench_lookups.db");
+    Database db(path);
+    if (!db.connect()) return 1;
+
+    // 1000 authors, years 1900-2019, and one book in 50 on loan to one of 100 users
+    std::vector<Book> books;
+    books.reserve(bookCount);
+    for (size_t i = 0; i < bookCount; ++i) {
+        Book book("Title " + std::to_string(i), "Author " + std::to_string(i % 1000), std::to_string(1900 + i % 120));
+        book.setBookID(book.generateID());
+        books.push_back(std::move(book));
+    }
+    db.addBooks(books);
+    std::vector<std::string> users;
+    for (int i = 0; i < 100; ++i) {
+        User user("User " + std::to_string(i), "user" + std::to_string(i) + "@example.com");
+        user.setUserID(user.generateID());
+        db.addUser(user);
+        users.push_back(user.getUserID());
+    }
+    for (size_t i = 0; i < bookCount; i += 50)
+        db.borrowBook(users[(i / 50) % users.size()], books[i].getBookID());
+
+    const std::string author = "Author 42";
+    const std::string& borrower = users[7];
+    auto inYears = [](const Book& book) {
+        int year = std::atoi(book.getPublicationYear().c_str());
+        return year >= 1990 && year <= 1994;
+    };
+    auto filter = [&](auto keep) {
+        std::vector<Book> matches;
+        for (Book& book : db.getAllBooks())
+            if (keep(book)) matches.push_back(std::move(book));
+        return matches;
+    };
+
+    struct Case {
+        const char* name;
+        std::function<std::vector<Book>()> indexed, scanned;
+    };
+    std::vector<Case> cases = {
+        {"author", [&] { return db.findBooksByAuthor(author); },
+                   [&] { return filter([&](const Book& b) { return b.getAuthor() == author; }); }},
+        {"year range", [&] { return db.findBooksByYearRange(1990, 1994); },
+                       [&] { return filter(inYears); }},
+        {"borrowed by", [&] { return db.findBooksBorrowedBy(borrower); },
+                        [&] { return filter([&](const Book& b) { return b.getCurrentUser() == borrower; }); }},
+    };
+
+    std::printf("%zu books\n%-12s %8s %12s %14s %9s\n", bookCount, "lookup", "matches", "indexed ms", "scan+filter ms", "speedup");
+    for (const Case& c : cases) {
+        size_t indexedCount = c.indexed().size(), scannedCount = c.scanned().size();
+        if (indexedCount != scannedCount) {
+            std::fprintf(stderr, "%s: index returned %zu books, scan %zu\n", c.name, indexedCount, scannedCount);
+            return 1;
+        }
+        double indexed = bench::bestOf(5, [&] { bench::consume(c.indexed()); });
+        double scanned = bench::bestOf(3, [&] { bench::consume(c.scanned()); });
+        std::printf("%-12s %8zu %12.3f %14.1f %8.0fx\n", c.name, indexedCount, indexed, scanned, scanned / indexed);
+    }
+
+    db.disconnect();
+    bench::removeDatabase(path);
+    return 0;
+}
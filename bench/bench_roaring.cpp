@@ -0,0 +1,77 @@
+// Times RoaringBitmap set operations and TagIndex queries with the AVX2 kernels
+// against the portable ones.
+//
+//   bench_roaring [books]        (default 2000000, for the TagIndex queries)
+#include "bench_common.h"
+#include "lms/Book.h"
+#include "lms/TagIndex.h"
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+using namespace lms;
+
+namespace {
+    RoaringBitmap randomBitmap(std::mt19937& rng, size_t count, uint32_t span) {
+        RoaringBitmap bitmap;
+        for (size_t i = 0; i < count; ++i) bitmap.add(rng() % span);
+        return bitmap;
+    }
+
+    // Microseconds per call of fn, best of a few runs of iterations calls
+    template <typename Fn>
+    double perCall(int iterations, Fn fn) {
+        return bench::bestOf(3, [&] {
+            for (int i = 0; i < iterations; ++i) fn();
+        }) * 1000 / iterations;
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t bookCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000000;
+    std::mt19937 rng(1);
+    // Sparse sets are array containers (merged), dense ones bitmap containers
+    RoaringBitmap sparseA = randomBitmap(rng, 2000, 65536), sparseB = randomBitmap(rng, 2000, 65536);
+    RoaringBitmap denseA = randomBitmap(rng, 1000000, 1u << 22), denseB = randomBitmap(rng, 1000000, 1u << 22);
+
+    // 50 tags, up to three per book
+    TagIndex index;
+    char id[33];
+    for (size_t i = 0; i < bookCount; ++i) {
+        std::snprintf(id, sizeof id, "%032zx", i);
+        std::string tags;
+        for (unsigned t = 0, n = rng() % 4; t < n; ++t) {
+            if (t) tags += kTagSeparator;
+            tags += "g" + std::to_string(rng() % 50);
+        }
+        index.setBook(id, tags);
+    }
+    TagQuery narrow, wide;
+    TagQuery::parse("g1 AND g2 NOT g3", narrow);
+    TagQuery::parse("(g1 OR g2 OR g5) AND NOT g7", wide);
+
+    bool simd = RoaringBitmap::usingSimd();
+    uint64_t sink = 0;
+    std::printf("%-32s %12s %12s\n", "operation (us)", "portable", "avx2");
+    auto row = [&](const char* name, int iterations, auto fn) {
+        RoaringBitmap::useSimd(false);
+        double portable = perCall(iterations, [&] { sink += fn(); });
+        if (RoaringBitmap::useSimd(true))
+            std::printf("%-32s %12.2f %12.2f\n", name, portable, perCall(iterations, [&] { sink += fn(); }));
+        else
+            std::printf("%-32s %12.2f %12s\n", name, portable, "n/a");
+    };
+    row("sparse AND", 20000, [&] { return (sparseA & sparseB).cardinality(); });
+    row("sparse OR", 20000, [&] { return (sparseA | sparseB).cardinality(); });
+    row("sparse AND NOT", 20000, [&] { return (sparseA - sparseB).cardinality(); });
+    row("dense AND", 200, [&] { return (denseA & denseB).cardinality(); });
+    row("dense OR", 200, [&] { return (denseA | denseB).cardinality(); });
+    row("dense AND NOT", 200, [&] { return (denseA - denseB).cardinality(); });
+    row("count(g1 AND g2 NOT g3)", 200, [&] { return index.count(narrow); });
+    row("count((g1 OR g2 OR g5) NOT g7)", 200, [&] { return index.count(wide); });
+    RoaringBitmap::useSimd(simd);
+    bench::consume(sink);
+    std::printf("%zu books in the index, %zu bytes of postings\n", index.bookCount(), index.memoryUsage());
+    return 0;
+}
@@ -0,0 +1,50 @@
+// Times ID hashing with picosha2 (what Book/User::generateID used to call) and
+// with each SHA-256 backend this CPU supports, one message at a time and batched.
+//
+//   bench_sha256 [messages]      (default 400000)
+#include "bench_common.h"
+#include "lms/Sha256.h"
+#include "picosha2.h"
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace lms;
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 400000;
+    // Shaped like the name+author+year strings IDs are generated from
+    std::vector<std::string> messages;
+    messages.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+        messages.push_back("Some Book Title " + std::to_string(i) + "Author Name" + std::to_string(1900 + i % 120));
+    std::vector<std::string_view> views(messages.begin(), messages.end());
+    std::vector<sha256::Digest> digests(views.size());
+
+    auto report = [&](const std::string& name, double ms) {
+        std::printf("%-24s %8.1f ns/message\n", name.c_str(), ms * 1e6 / count);
+    };
+    report("picosha2 (hex)", bench::bestOf(3, [&] {
+        for (const std::string& message : messages) bench::consume(picosha2::hash256_hex_string(message));
+    }));
+
+    const sha256::Backend backends[] = {sha256::Backend::Portable, sha256::Backend::ShaNi, sha256::Backend::Avx2};
+    for (sha256::Backend backend : backends) {
+        // Avx2 only batches, so pair it with the portable single-message path
+        sha256::Backend single = backend == sha256::Backend::Avx2 ? sha256::Backend::Portable : backend;
+        if (single == backend && sha256::useBackends(single, sha256::Backend::Portable)) {
+            report(std::string("hash ") + sha256::backendName(backend), bench::bestOf(3, [&] {
+                for (size_t i = 0; i < views.size(); ++i) digests[i] = sha256::hash(views[i]);
+            }));
+        }
+        if (sha256::useBackends(single, backend)) {
+            report(std::string("hashMany ") + sha256::backendName(backend), bench::bestOf(3, [&] {
+                sha256::hashMany(views.data(), views.size(), digests.data());
+            }));
+        }
+    }
+    report("toHex (16 bytes)", bench::bestOf(3, [&] {
+        for (const sha256::Digest& digest : digests) bench::consume(sha256::toHex(digest.data(), 16));
+    }));
+    return 0;
+}
@@ -1,12 +1,54 @@
 #pragma once
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
+#include "Id.h"
 
 namespace lms {
 
 class Database; // Forward declaration for Database class
 
+// Separates tags in BookView::tags (ASCII unit separator, which cannot be typed
+// into a tag the way a comma can)
+constexpr char kTagSeparator = '\x1f';
+
+// Read-only, non-owning view of a book row. The string_views point into SQLite's
+// column memory and are only valid while the callback that received the view runs.
+struct BookView {
+    std::string_view bookID;
+    std::string_view name;
+    std::string_view author;
+    std::string_view year;
+    std::string_view currentUser;
+    std::string_view tags;                          // Tags joined by kTagSeparator
+    bool isAvailable = true;
+
+    // Calls fn(std::string_view) for every tag, without allocating
+    template <typename Fn>
+    void forEachTag(Fn fn) const {
+        size_t start = 0;
+        while (start < tags.size()) {
+            size_t end = tags.find(kTagSeparator, start);
+            if (end == std::string_view::npos) end = tags.size();
+            fn(tags.substr(start, end - start));
+            start = end + 1;
+        }
+    }
+};
+
 class Book {
+public:
+    // Bits of dirtyFields(), one per stored column
+    enum Field : uint8_t {
+        NameField           = 1 << 0,
+        AuthorField         = 1 << 1,
+        YearField           = 1 << 2,
+        CurrentUserField    = 1 << 3,
+        TagsField           = 1 << 4,
+        AllFields           = (1 << 5) - 1
+    };
+
 private:
     std::string bookID              = "";
     std::string name                = "";
@@ -15,33 +57,44 @@ private:
     std::string currentUser         = "";
     std::vector<std::string> tags   = {};           // Added: tags for categorization
     bool isAvailable                = true;         // Added: availability status
+    uint8_t dirty                   = AllFields;    // Fields set since the book was loaded
 
 public:
     // Use default values for all parameters, so a single constructor can be used for all cases
-    Book(const std::string& name = "", const std::string& author = "", const std::string& year = "");
+    Book(std::string name = "", std::string author = "", std::string year = "");
     
-    // Getters
-    std::string getBookID() const;
-    std::string getBookName() const;
-    std::string getAuthor() const;
-    std::string getCurrentUser() const;
-    std::string getPublicationYear() const;
-    std::vector<std::string> getTags() const;
-    bool available() const;
-
-    // Setters
-    void setBookID(const std::string& _bookID);
-    void setBookName(const std::string& _name);
-    void setAuthor(const std::string& _author);
-    void setCurrentUser(const std::string& _currentUser);
-    void setPublicationYear(const std::string& _year);
-    void addTag(const std::string& _tag);
-    void setTags(const std::vector<std::string>& _tags);
+    // Getters return references into the book, valid until it is modified or destroyed
+    const std::string& getBookID() const { return bookID; }
+    BookId getID() const;                           // Null if the ID is not canonical hex
+    const std::string& getBookName() const { return name; }
+    const std::string& getAuthor() const { return author; }
+    const std::string& getCurrentUser() const { return currentUser; }
+    const std::string& getPublicationYear() const { return year; }
+    const std::vector<std::string>& getTags() const { return tags; }
+    bool available() const { return isAvailable; }
+
+    // Setters take their argument by value, so callers can move into them
+    void setBookID(std::string _bookID);
+    void setID(const BookId& _bookID);
+    void setBookName(std::string _name);
+    void setAuthor(std::string _author);
+    void setCurrentUser(std::string _currentUser);
+    void setPublicationYear(std::string _year);
+    void addTag(std::string _tag);
+    void setTags(std::vector<std::string> _tags);
     void setAvailable(bool _status);
 
+    // Fields changed since the book was read from the database (every field for a
+    // book built in memory); updateBook writes only these
+    uint8_t dirtyFields() const { return dirty; }
+    void markClean() { dirty = 0; }
+
     // Generators
     std::string generateID() const;
+    std::string generateID(IdStrategy strategy) const;
     std::string generateTagString() const;
+    // Gives every book without an ID a generated one; content hashes are computed in batches
+    static void generateIDs(std::vector<Book>& books, IdStrategy strategy = IdStrategy::ContentHash);
 
     // Update this book's data in the database
     bool updateInDB(Database& db) const;
@@ -0,0 +1,212 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Book.h"
+#include "Id.h"
+#include "User.h"
+
+namespace lms {
+    // Immutable map from ID to row, in the order SQL "ORDER BY id" returns them:
+    // custom IDs (stored as TEXT) first, then canonical IDs (stored as BLOB), each
+    // group in byte order. Rows live in 2 x 256 x 256 leaves picked by that group and
+    // the first two bytes of the ID (so walking the leaves in order walks the IDs in
+    // order); each leaf is a sorted vector of shared rows. A new version copies only
+    // the leaves it changes and shares everything else with the old one.
+    template <typename T>
+    class SnapshotTable {
+    public:
+        struct Row {
+            std::string id;
+            T value;
+        };
+
+        // A pending edit: a value replaces or inserts the row, nullopt removes it
+        using Change = std::pair<std::string, std::optional<T>>;
+
+        const T* find(const std::string& id) const {
+            const Leaf* leaf = leafFor(id);
+            if (!leaf) return nullptr;
+            auto it = std::lower_bound(leaf->begin(), leaf->end(), id, lessThanID);
+            return it != leaf->end() && (*it)->id == id ? &(*it)->value : nullptr;
+        }
+
+        size_t size() const { return count; }
+
+        // Calls visit(const T&) for every row with an ID greater than lastID, in ID
+        // order, until it returns false. Pass "" to start at the first row.
+        template <typename Fn>
+        void forEachAfter(const std::string& lastID, Fn visit) const {
+            size_t first = lastID.empty() ? 0 : bucketOf(lastID);
+            for (size_t bucket = first; bucket < kTops * kBuckets; ++bucket) {
+                const Node* node = nodes[bucket / kBuckets].get();
+                if (!node) {
+                    bucket = (bucket / kBuckets + 1) * kBuckets - 1;
+                    continue;
+                }
+                const Leaf* leaf = (*node)[bucket % kBuckets].get();
+                if (!leaf) continue;
+                auto it = bucket == first && !lastID.empty()
+                    ? std::upper_bound(leaf->begin(), leaf->end(), lastID, greaterThanID)
+                    : leaf->begin();
+                for (; it != leaf->end(); ++it)
+                    if (!visit((*it)->value)) return;
+            }
+        }
+
+        // Returns the next version with changes applied; a later change to the same
+        // ID wins over an earlier one
+        SnapshotTable apply(std::vector<Change> changes) const {
+            std::stable_sort(changes.begin(), changes.end(),
+                             [](const Change& a, const Change& b) { return precedes(a.first, b.first); });
+            SnapshotTable next = *this;
+            size_t i = 0;
+            while (i < changes.size()) {
+                size_t top = bucketOf(changes[i].first) / kBuckets;
+                auto node = nodes[top] ? std::make_shared<Node>(*nodes[top]) : std::make_shared<Node>();
+                while (i < changes.size() && bucketOf(changes[i].first) / kBuckets == top) {
+                    size_t slot = bucketOf(changes[i].first) % kBuckets;
+                    auto leaf = (*node)[slot] ? std::make_shared<Leaf>(*(*node)[slot]) : std::make_shared<Leaf>();
+                    for (; i < changes.size() && bucketOf(changes[i].first) == top * kBuckets + slot; ++i)
+                        next.count += applyToLeaf(*leaf, changes[i]);
+                    (*node)[slot] = leaf->empty() ? nullptr : std::move(leaf);
+                }
+                next.nodes[top] = std::move(node);
+            }
+            return next;
+        }
+
+    private:
+        static constexpr size_t kBuckets = 256;
+        static constexpr size_t kTops = 2 * kBuckets;  // Custom IDs, then canonical ones
+        using RowPtr = std::shared_ptr<const Row>;
+        using Leaf = std::vector<RowPtr>;
+        using Node = std::array<std::shared_ptr<const Leaf>, kBuckets>;
+
+        static bool lessThanID(const RowPtr& row, const std::string& id) { return row->id < id; }
+        static bool greaterThanID(const std::string& id, const RowPtr& row) { return id < row->id; }
+
+        // Book and user IDs share one canonical form
+        static bool isCanonical(const std::string& id) {
+            BookId parsed;
+            return BookId::parse(id, parsed);
+        }
+
+        // The table order; plain string order is enough within one leaf, since a
+        // leaf never mixes custom and canonical IDs
+        static bool precedes(const std::string& a, const std::string& b) {
+            bool canonicalA = isCanonical(a), canonicalB = isCanonical(b);
+            return canonicalA != canonicalB ? canonicalB : a < b;
+        }
+
+        // Bytes past the end count as 0, which keeps "a" ahead of "ab"
+        static size_t bucketOf(const std::string& id) {
+            size_t group = isCanonical(id) ? kBuckets : 0;
+            size_t high = id.size() > 0 ? static_cast<unsigned char>(id[0]) : 0;
+            size_t low = id.size() > 1 ? static_cast<unsigned char>(id[1]) : 0;
+            return (group + high) * kBuckets + low;
+        }
+
+        const Leaf* leafFor(const std::string& id) const {
+            size_t bucket = bucketOf(id);
+            const Node* node = nodes[bucket / kBuckets].get();
+            return node ? (*node)[bucket % kBuckets].get() : nullptr;
+        }
+
+        // Returns the change in row count (+1, 0 or -1)
+        static std::ptrdiff_t applyToLeaf(Leaf& leaf, Change& change) {
+            auto it = std::lower_bound(leaf.begin(), leaf.end(), change.first, lessThanID);
+            bool present = it != leaf.end() && (*it)->id == change.first;
+            if (!change.second) {
+                if (!present) return 0;
+                leaf.erase(it);
+                return -1;
+            }
+            auto row = std::make_shared<const Row>(Row{change.first, std::move(*change.second)});
+            if (present) {
+                *it = std::move(row);
+                return 0;
+            }
+            leaf.insert(it, std::move(row));
+            return 1;
+        }
+
+        std::array<std::shared_ptr<const Node>, kTops> nodes;
+        size_t count = 0;
+    };
+
+    // One consistent version of the whole catalog. Never modified once published,
+    // so any number of threads may read it without synchronization.
+    class CatalogSnapshot {
+    public:
+        // Increases by one with every published change
+        uint64_t version() const { return versionNumber; }
+
+        // Pointers stay valid for as long as the snapshot is alive
+        const Book* findBook(const std::string& bookID) const { return books.find(bookID); }
+        const User* findUser(const std::string& userID) const { return users.find(userID); }
+        size_t bookCount() const { return books.size(); }
+        size_t userCount() const { return users.size(); }
+
+        // Same paging contract as Database::listBooksAfter / listUsersAfter
+        std::vector<const Book*> listBooksAfter(const std::string& lastID, int limit) const;
+        std::vector<const User*> listUsersAfter(const std::string& lastID, int limit) const;
+        // Case-insensitive substring match on title or author, in ID order; a
+        // negative limit returns every match
+        std::vector<const Book*> searchBooks(const std::string& text, int limit = -1) const;
+
+        // Visit every row in ID order until visit returns false
+        template <typename Fn>
+        void forEachBook(Fn visit) const { books.forEachAfter("", visit); }
+        template <typename Fn>
+        void forEachUser(Fn visit) const { users.forEachAfter("", visit); }
+
+    private:
+        friend class CatalogMirror;
+
+        uint64_t versionNumber = 0;
+        SnapshotTable<Book> books;
+        SnapshotTable<User> users;
+    };
+
+    // Owns the current CatalogSnapshot. A writer builds the next version from the
+    // current one plus the rows it changed and swaps it in. Readers never wait for a
+    // writer to build a version, but loading one is not lock-free: std::atomic_load
+    // on a shared_ptr takes one of libstdc++'s pooled mutexes around the copy.
+    // current() skips even that while no new version was published.
+    class CatalogMirror {
+    public:
+        CatalogMirror();
+
+        // The latest version; hold on to it for a consistent view across calls
+        std::shared_ptr<const CatalogSnapshot> snapshot() const;
+        // The latest version through a per-thread cache, so repeated calls touch no
+        // shared reference count while nothing changes. The reference is only valid
+        // until this thread calls current() again.
+        const CatalogSnapshot& current() const;
+
+        // Replaces the whole catalog
+        void reset(std::vector<Book> books, std::vector<User> users);
+        // Publishes a version in which the given books and users are inserted or
+        // replaced and the removed IDs are gone
+        void publish(std::vector<Book> books, const std::vector<std::string>& removedBooks,
+                     std::vector<User> users, const std::vector<std::string>& removedUsers);
+
+    private:
+        void install(std::shared_ptr<CatalogSnapshot> next);
+
+        const uint64_t mirrorID;
+        std::shared_ptr<const CatalogSnapshot> latest;  // Accessed only with std::atomic_load/store
+                                                        // (C++20 would allow std::atomic<shared_ptr>)
+        std::atomic<uint64_t> latestVersion{0};
+        std::mutex publishMutex;                        // Serializes writers, never taken by readers
+    };
+}
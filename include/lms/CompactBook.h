@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include "Book.h"
+#include "Id.h"
+#include "SmallVector.h"
+#include "StringPool.h"
+
+namespace lms {
+    // A book packed for in-memory working sets such as the object cache: 64 bytes
+    // plus one allocation for the name, against 192 bytes and up to eight
+    // allocations for a Book. Author, year and tags are StringPool handles (the
+    // first four tags inline); the availability and borrowed flags share a word
+    // with the name length. The borrower's ID (16 bytes, or text if it is not
+    // canonical) and a non-canonical book ID follow the name in the same
+    // allocation. A CompactBook is only meaningful together with the pool it was
+    // built with, and only holds books for which fits() is true.
+    class CompactBook {
+    public:
+        CompactBook() = default;
+        // Requires fits(book)
+        CompactBook(const Book& book, StringPool& pool);
+        CompactBook(const CompactBook& other);
+        CompactBook(CompactBook&&) noexcept = default;
+        CompactBook& operator=(const CompactBook& other);
+        CompactBook& operator=(CompactBook&&) noexcept = default;
+
+        // False for the rare book whose name (1 GiB) or custom book or borrower ID
+        // (64 KiB) is too long for the packed lengths; callers keep those uncached
+        static bool fits(const Book& book);
+
+        // Re-interns the author, year and tags from the pool the book was built with
+        // into another, after which the book belongs to that one
+        void moveStrings(const StringPool& from, StringPool& to);
+
+        // The full Book, marked clean like a freshly loaded row
+        Book toBook(const StringPool& pool) const;
+
+        const BookId& getID() const { return id; }
+        std::string_view getBookName() const { return std::string_view(text.get(), nameLength()); }
+        StringPool::Handle getAuthor() const { return author; }
+        StringPool::Handle getPublicationYear() const { return year; }
+        const SmallVector<StringPool::Handle, 4>& getTags() const { return tags; }
+        bool available() const { return (packed & kAvailableBit) != 0; }
+
+    private:
+        static constexpr uint32_t kAvailableBit = 1u << 31;
+        static constexpr uint32_t kBorrowedBit = 1u << 30;   // A canonical borrower ID is stored
+        static constexpr uint32_t kLengthMask = kBorrowedBit - 1;
+        static constexpr size_t kMaxCustomLength = UINT16_MAX;
+
+        uint32_t nameLength() const { return packed & kLengthMask; }
+        size_t userIdLength() const { return packed & kBorrowedBit ? UserId::kSize : 0; }
+        size_t textLength() const { return nameLength() + userIdLength() + customIdLength + customUserLength; }
+
+        BookId id;                                  // Null when customIdLength > 0
+        std::unique_ptr<char[]> text;               // Name, user ID bytes, custom book ID, custom user ID
+        uint32_t packed = kAvailableBit;            // Name length | flags
+        uint16_t customIdLength = 0;
+        uint16_t customUserLength = 0;
+        StringPool::Handle author = StringPool::kEmpty;
+        StringPool::Handle year = StringPool::kEmpty;
+        SmallVector<StringPool::Handle, 4> tags;
+    };
+}
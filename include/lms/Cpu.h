@@ -0,0 +1,26 @@
+#pragma once
+
+// LMS_TARGET compiles one function for instruction set extensions the rest of the
+// build does not assume; such functions may only run after the matching check
+// below has passed.
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define LMS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define LMS_TARGET(features)
+#else
+#define LMS_TARGET(features) __attribute__((target(features)))
+#endif
+#else
+#define LMS_X86 0
+#define LMS_TARGET(features)
+#endif
+
+namespace lms {
+    // Runtime CPU feature checks; always false on other architectures
+    namespace cpu {
+        bool hasShaNi();    // SHA extensions, with the SSSE3 / SSE4.1 they are used with
+        bool hasAvx2();     // Including OS support for the YMM registers
+        bool hasPopcnt();
+    }
+}
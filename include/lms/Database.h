@@ -1,37 +1,315 @@
 #pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include "../lib/sqlite3/sqlite3.h"
 #include "Book.h"
+#include "CatalogSnapshot.h"
+#include "CompactBook.h"
+#include "Id.h"
+#include "TagIndex.h"
+#include "TinyLfuCache.h"
 #include "User.h"
 
 namespace lms {
+    // Outcome of Database::borrowBook / returnBook
+    enum class LoanStatus {
+        Success,
+        UserNotFound,
+        BookNotFound,
+        Conflict,       // The book is already borrowed by someone
+        NotBorrowed,    // The user does not hold the book
+        Error
+    };
+
+    // One hit from Database::searchBooks
+    struct SearchResult {
+        Book book;
+        double score;           // BM25 relevance, higher is better
+        std::string snippet;    // Best matching field with hits wrapped in [ ]
+    };
+
+    // Tuning for Database::startAsyncWrites
+    struct AsyncWriteOptions {
+        size_t maxBatchSize = 256;                          // Writes committed per transaction
+        std::chrono::microseconds maxDelay{2000};           // How long a write may wait for its batch to fill
+    };
+
+    // Counters for the async writer; latencies run from enqueue to durable commit
+    struct AsyncWriteStats {
+        uint64_t batches = 0;
+        uint64_t writes = 0;
+        uint64_t failedBatches = 0;
+        size_t largestBatch = 0;
+        double averageBatchSize = 0.0;
+        double averageLatencyMs = 0.0;
+        double maxLatencyMs = 0.0;
+    };
+
     class Database {
     private:
+        // A SQLite connection with its prepared statements, keyed by SQL text and
+        // reused until disconnect()
+        struct Connection {
+            sqlite3* handle = nullptr;
+            std::unordered_map<std::string, sqlite3_stmt*> statements;
+        };
+
+        // Exclusive use of one connection for the duration of a call: either the
+        // writer (under writerMutex) or an idle reader taken from the pool
+        class ConnectionLease {
+        public:
+            ConnectionLease(const Database& owner, Connection& conn, std::unique_lock<std::mutex> writerLock);
+            ConnectionLease(ConnectionLease&& other) noexcept;
+            ConnectionLease(const ConnectionLease&) = delete;
+            ConnectionLease& operator=(const ConnectionLease&) = delete;
+            ~ConnectionLease();
+            Connection& operator*() const { return *conn; }
+        private:
+            const Database* owner;
+            Connection* conn;
+            std::unique_lock<std::mutex> writerLock;
+        };
+
         std::string dbPath;
-        sqlite3* db = nullptr;
+        size_t readerCount = 0;
         bool connected = false;
 
+        mutable Connection writer;
+        std::vector<std::unique_ptr<Connection>> readers;
+        mutable std::vector<Connection*> idleReaders;
+        mutable std::mutex writerMutex;
+        mutable std::mutex readerMutex;
+        mutable std::condition_variable readerAvailable;
+
+        // A queued async mutation: apply runs inside the batch transaction and returns
+        // false if the write failed, complete fulfils the caller's future once the
+        // batch has committed (or failed)
+        struct PendingWrite {
+            std::function<bool(Connection&)> apply;
+            std::function<void(bool committed)> complete;
+            std::chrono::steady_clock::time_point enqueued;
+        };
+
+        AsyncWriteOptions asyncOptions;
+        std::thread asyncWriter;
+        std::mutex queueMutex;
+        std::condition_variable queueReady;
+        std::deque<PendingWrite> writeQueue;
+        bool asyncRunning = false;
+        bool asyncStopping = false;
+        mutable std::mutex statsMutex;
+        AsyncWriteStats asyncStats;
+
+        // Read-through caches for getBook/getUser, holding canonical IDs only. Writes
+        // record the rows they touch (under writerMutex); publishChanges() invalidates
+        // them once committed and bumps cacheEpoch so loads that raced with the write
+        // are not cached. Books are cached as CompactBook, with their authors, years
+        // and tags interned in bookStrings. The pool never forgets a string, so once
+        // it outgrows bookStringsLimit it is rebuilt from the books still cached
+        // (rebuildBookStrings), under bookStringsMutex held exclusively; every use of
+        // the pool holds it shared.
+        mutable std::shared_mutex bookStringsMutex;
+        mutable std::unique_ptr<StringPool> bookStrings;
+        mutable size_t bookStringsLimit = 0;
+        size_t bookStringsBaseLimit = 0;
+        std::unique_ptr<TinyLfuCache<BookId, CompactBook>> bookCache;
+        std::unique_ptr<TinyLfuCache<UserId, User>> userCache;
+        mutable std::atomic<uint64_t> cacheEpoch{0};
+        std::vector<std::string> changedBooks;
+        std::vector<std::string> changedUsers;
+
+        // Optional in-memory copy of the catalog, refreshed from the writer connection
+        // with the touched rows after every commit
+        std::unique_ptr<CatalogMirror> catalog;
+        // Optional tag index, refreshed the same way
+        std::unique_ptr<TagIndex> tagPostings;
+
+        void rebuildBookStrings() const;
+        void touchBook(const std::string& bookID);
+        void touchUser(const std::string& userID);
+        // Called on the writer once the touched rows are committed (or rolled back)
+        void publishChanges(Connection& conn);
+        void refreshCatalog(Connection& conn);
+        void refreshTagIndex(Connection& conn);
+
+        mutable std::atomic<uint64_t> statementHits{0};
+        mutable std::atomic<uint64_t> statementMisses{0};
+
+        ConnectionLease acquireWriter() const;
+        ConnectionLease acquireReader() const;
+        void releaseReader(Connection* conn) const;
+
+        sqlite3_stmt* prepare(Connection& conn, const char* sql) const;
+        bool exec(Connection& conn, const char* sql) const;
+        static void closeConnection(Connection& conn);
+
+        // Schema migrations run by connect(), tracked with PRAGMA user_version
+        bool migrate(Connection& conn);
+        bool migrateBookTags(Connection& conn);
+        bool migrateLoans(Connection& conn);
+        bool migrateSearchIndex(Connection& conn);
+        bool migrateLookupIndexes(Connection& conn);
+        bool migrateBinaryIds(Connection& conn);
+        bool migrateContentHash(Connection& conn);
+        bool migrateSearchRowids(Connection& conn);
+
+        // Replaces the book_tags rows of one book
+        bool writeTags(Connection& conn, const std::string& bookID, const std::vector<std::string>& tags);
+
+        // Write operations on a connection the caller already holds, shared by the
+        // public methods, the batch inserts and the async writer
+        bool addBook(Connection& conn, const Book& book);
+        bool removeBook(Connection& conn, const std::string& bookID);
+        bool updateBook(Connection& conn, const Book& book);
+        bool addUser(Connection& conn, const User& user);
+        bool removeUser(Connection& conn, const std::string& userID);
+        bool updateUser(Connection& conn, const User& user);
+        LoanStatus borrowBook(Connection& conn, const std::string& userID, const std::string& bookID);
+        LoanStatus returnBook(Connection& conn, const std::string& userID, const std::string& bookID);
+        // Single-row lookups by ID on a reader, uncached; bind fills in the ID
+        Book loadBook(const std::function<void(sqlite3_stmt*)>& bind) const;
+        User loadUser(const std::function<void(sqlite3_stmt*)>& bind) const;
+        // Runs a book query on a reader; bind fills in its parameters
+        std::vector<Book> selectBooks(const char* sql, const std::function<void(sqlite3_stmt*)>& bind) const;
+        // Queues op for the async writer, or runs it right away when async writes are off
+        template <typename T>
+        std::future<T> enqueueWrite(std::function<T(Connection&)> op, T failure);
+        void asyncWriterLoop();
+        void commitBatch(std::vector<PendingWrite>& batch);
+
+        std::vector<bool> insertInChunks(size_t count, size_t chunkSize, const std::function<bool(Connection&, size_t)>& insertRow);
+
     public:
-        Database(const std::string& dbPath);
+        // With readerConnections > 0 the database is opened in WAL mode and reads run on
+        // a pool of read-only connections in parallel; writes always go to one writer
+        // connection. Every operation is safe to call from multiple threads, but
+        // connect() and disconnect() must not race with other calls.
+        Database(const std::string& dbPath, size_t readerConnections = 0);
         ~Database();
         
         bool connect();
         void disconnect();
         bool isConnected() const;
+
+        // Write-behind mode: the *Async mutations below are queued and a dedicated
+        // thread commits them in groups, one transaction per batch or time window.
+        // Each future completes once its batch is durably committed. Synchronous
+        // writes remain available and are serialized with the batches.
+        bool startAsyncWrites(const AsyncWriteOptions& options = AsyncWriteOptions());
+        // Drains the queue and stops the writer thread; also done by disconnect()
+        void stopAsyncWrites();
+        AsyncWriteStats asyncWriteStats() const;
+
+        std::future<bool> addBookAsync(const Book& book);
+        std::future<bool> updateBookAsync(const Book& book);
+        std::future<bool> removeBookAsync(const std::string& bookID);
+        std::future<bool> addUserAsync(const User& user);
+        std::future<bool> updateUserAsync(const User& user);
+        std::future<bool> removeUserAsync(const std::string& userID);
+        std::future<LoanStatus> borrowBookAsync(const std::string& userID, const std::string& bookID);
+        std::future<LoanStatus> returnBookAsync(const std::string& userID, const std::string& bookID);
+
+        // Puts a bounded W-TinyLFU cache of bookCapacity books and userCapacity users in
+        // front of getBook/getUser (0 disables one). Writes through this Database
+        // invalidate cached rows. Call after connect(), before sharing the Database.
+        void enableObjectCache(size_t bookCapacity, size_t userCapacity);
+        CacheStats bookCacheStats() const;
+        CacheStats userCacheStats() const;
+
+        // Keeps a CatalogMirror of every book and user in memory, so readers can list and
+        // look up the catalog through immutable snapshots without touching SQLite.
+        // Writes through this Database publish a new snapshot as soon as they commit.
+        // Call after connect(), before sharing the Database.
+        bool enableCatalogMirror();
+        // nullptr unless enableCatalogMirror() succeeded
+        const CatalogMirror* catalogMirror() const;
+
+        // Loads every book's tags into a TagIndex, which writes through this Database
+        // keep current as they commit. Call after connect(), before sharing the Database.
+        bool enableTagIndex();
+        // nullptr unless enableTagIndex() succeeded
+        const TagIndex* tagIndex() const;
+
+        // Statement cache statistics
+        uint64_t statementCacheHits() const;
+        uint64_t statementCacheMisses() const;
         
         // Book operations
         bool addBook(const Book& book);
+        // Inserts books in explicit transactions of chunkSize rows, returning per-row success
+        std::vector<bool> addBooks(const std::vector<Book>& books, size_t chunkSize = 1000);
         bool removeBook(const std::string& bookID);
+        // Writes only the fields set since the book was loaded (Book::dirtyFields), and
+        // nothing at all for an unchanged book; the same holds for updateUser
         bool updateBook(const Book& book);
         Book getBook(const std::string& bookID) const;
+        // Typed lookups bind the 16 bytes directly, with no hex round trip. Writes only
+        // take the string form: they record changed IDs as text for the caches and the
+        // mirror, so a typed overload would just convert back.
+        Book getBook(const BookId& bookID) const;
         std::vector<Book> getAllBooks() const;
+        // Returns up to limit books ordered by id with id > lastID; pass "" for the first
+        // page and the last id of the previous page afterwards
+        std::vector<Book> listBooksAfter(const std::string& lastID, int limit) const;
+        // Index lookups on book_tags; a negative limit returns every match
+        std::vector<Book> findBooksByTag(const std::string& tag, int limit = -1) const;
+        // Books carrying every one of tags (an empty list matches nothing)
+        std::vector<Book> findBooksByAllTags(const std::vector<std::string>& tags, int limit = -1) const;
+        // Books matching a TagQuery such as "fantasy AND young-adult NOT horror", in ID
+        // order. Evaluated on the tag index when it is enabled, by a full scan otherwise;
+        // an invalid query is reported and matches nothing.
+        std::vector<Book> findBooksByTagQuery(const std::string& query, int limit = -1) const;
+        // The same matches as IDs only, or just their number, without reading the rows
+        std::vector<std::string> findBookIDsByTagQuery(const std::string& query, int limit = -1) const;
+        uint64_t countBooksByTagQuery(const std::string& query) const;
+        // Index lookups on author, publication year (inclusive, compared numerically) and
+        // current borrower; a negative limit returns every match
+        std::vector<Book> findBooksByAuthor(const std::string& author, int limit = -1) const;
+        std::vector<Book> findBooksByYearRange(int fromYear, int toYear, int limit = -1) const;
+        std::vector<Book> findBooksBorrowedBy(const std::string& userID, int limit = -1) const;
+        // Full-text search over titles and authors, best matches first. Every word of
+        // query must match the start of a word in the title or author.
+        std::vector<SearchResult> searchBooks(const std::string& query, int limit = 20) const;
+        // Streams every book to visit one row at a time; return false from visit to stop.
+        // The Book reference is only valid during the callback, and visit must not call
+        // back into this Database. Returns false if the query failed.
+        bool forEachBook(const std::function<bool(const Book&)>& visit) const;
+        // Like forEachBook, but hands out views of SQLite's column memory, so a scan
+        // copies nothing and allocates nothing per row
+        bool forEachBookView(const std::function<bool(const BookView&)>& visit) const;
         
-        // User operations
+        // User operations. A user's borrowed books are read from the loans table;
+        // addUser/updateUser do not write them, use borrowBook/returnBook instead.
         bool addUser(const User& user);
+        std::vector<bool> addUsers(const std::vector<User>& users, size_t chunkSize = 1000);
         bool removeUser(const std::string& userID);
         bool updateUser(const User& user);
         User getUser(const std::string& userID) const;
+        User getUser(const UserId& userID) const;
         std::vector<User> getAllUsers() const;
+        std::vector<User> listUsersAfter(const std::string& lastID, int limit) const;
+        bool forEachUser(const std::function<bool(const User&)>& visit) const;
+        bool forEachUserView(const std::function<bool(const UserView&)>& visit) const;
+
+        // Loan operations. Each runs in a single IMMEDIATE transaction; the book is
+        // claimed with a conditional UPDATE so concurrent borrows cannot both succeed.
+        LoanStatus borrowBook(const std::string& userID, const std::string& bookID);
+        LoanStatus returnBook(const std::string& userID, const std::string& bookID);
+        // ID of the user currently holding bookID, or "" if it is not on loan
+        std::string getBorrower(const std::string& bookID) const;
+        // Null if the book is not on loan or its borrower has a custom ID
+        UserId getBorrower(const BookId& bookID) const;
     };
 }
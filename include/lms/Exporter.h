@@ -0,0 +1,94 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Database.h"
+
+namespace lms {
+    enum class ExportFormat { Csv, JsonLines, Columnar };
+
+    struct ExportOptions {
+        ExportFormat format = ExportFormat::Csv;
+        size_t bufferBytes = 1 << 20;       // Output is written in blocks of this size
+        size_t rowGroupRows = 65536;        // Columnar only: rows per row group
+    };
+
+    struct ExportStats {
+        uint64_t rows = 0;
+        uint64_t bytes = 0;
+        double elapsedSeconds = 0.0;
+
+        double megabytesPerSecond() const { return elapsedSeconds > 0 ? bytes / elapsedSeconds / (1024.0 * 1024.0) : 0.0; }
+    };
+
+    // Appends to a fixed-size buffer and hands it to the file only when full, so
+    // formatting a row costs a few memcpys and no allocations
+    class BufferedWriter {
+    public:
+        BufferedWriter(std::FILE* file, size_t capacity);
+        ~BufferedWriter();
+        BufferedWriter(const BufferedWriter&) = delete;
+        BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+        void put(char c) {
+            if (used == buffer.size()) drain();
+            buffer[used++] = c;
+        }
+        void put(std::string_view text);
+        // Little-endian fixed-width integers for binary formats
+        void putLE32(uint32_t value);
+        void putLE64(uint64_t value);
+
+        bool flush();
+        uint64_t bytesWritten() const { return written + used; }
+        bool ok() const { return !failed; }
+
+    private:
+        void drain();
+
+        std::FILE* file;
+        std::vector<char> buffer;
+        size_t used = 0;
+        uint64_t written = 0;
+        bool failed = false;
+    };
+
+    // Dumps the books or users table to a file, streaming rows from
+    // Database::forEachBookView / forEachUserView so memory does not grow with the
+    // table. CSV and JSON Lines use the columns and tag separator (';') that
+    // Importer reads back; in CSV a ';' or backslash inside a tag is escaped with
+    // a backslash. The columnar format is laid out like this, with every
+    // integer little-endian:
+    //
+    //   file      "LMSC" u32 version, row groups..., footer, u32 footer size, "LMSC"
+    //   row group one chunk per column, in column order
+    //   chunk     string column: u32 length per row, then the row bytes back to back
+    //             bool column:   one byte per row
+    //   footer    u32 column count, per column (u8 type, u32 name size, name),
+    //             u32 row group count, per row group (u32 rows, per column
+    //             (u64 offset, u64 size)), u64 total rows
+    //
+    // String column types are 0 and bool columns 1. Tags keep their stored separator
+    // (kTagSeparator), borrowed books their ','.
+    class Exporter {
+    public:
+        static constexpr uint32_t kColumnarVersion = 1;
+
+        Exporter(const Database& db, const ExportOptions& options = ExportOptions());
+
+        // Return false if the file could not be written or the table not read
+        bool exportBooks(const std::string& path);
+        bool exportUsers(const std::string& path);
+        const ExportStats& stats() const { return totals; }
+
+    private:
+        bool run(const std::string& path, bool books);
+
+        const Database& db;
+        ExportOptions options;
+        ExportStats totals;
+    };
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace lms {
+    // How generateID assigns new IDs. ContentHash is a SHA-256 prefix of the row's
+    // fields, so it is stable but scatters inserts across the B-tree; TimeOrdered
+    // IDs increase over time, so inserts append at the right edge of the index.
+    // Either way the database rejects a second row with the same content through
+    // its content_hash index.
+    enum class IdStrategy { ContentHash, TimeOrdered };
+
+    // Fills bytes[0..16) with a new UUIDv7-style ID (RFC 9562): 48-bit Unix time in
+    // milliseconds, version 7, a 12-bit counter, variant 10 and 62 random bits.
+    // IDs from one process are strictly increasing, also within one millisecond.
+    void generateTimeOrderedId(uint8_t* bytes);
+
+    // A 128-bit ID held by value: the 16 bytes behind the 32 lowercase hex digits
+    // generateID produces, which is also how the database stores them. Copying,
+    // hashing and comparing never allocate, and the byte order matches the order of
+    // the hex strings. Tag keeps book and user IDs apart at compile time.
+    //
+    // The all-zero ID is null ("no ID"). IDs that are not canonical hex (custom IDs
+    // set with setBookID / setUserID) have no BasicId form and only go through the
+    // std::string API.
+    template <typename Tag>
+    class BasicId {
+    public:
+        static constexpr size_t kSize = 16;
+        static constexpr size_t kHexLength = 2 * kSize;
+
+        constexpr BasicId() = default;
+
+        static BasicId fromBytes(const void* data) {
+            BasicId id;
+            std::memcpy(id.bytes.data(), data, kSize);
+            return id;
+        }
+
+        static BasicId timeOrdered() {
+            BasicId id;
+            generateTimeOrderedId(id.bytes.data());
+            return id;
+        }
+
+        // Fills out and returns true only if text is exactly 32 lowercase hex digits
+        static bool parse(std::string_view text, BasicId& out) {
+            if (text.size() != kHexLength) return false;
+            std::array<uint8_t, kSize> parsed;
+            for (size_t i = 0; i < kSize; ++i) {
+                int high = nibble(text[2 * i]), low = nibble(text[2 * i + 1]);
+                if (high < 0 || low < 0) return false;
+                parsed[i] = static_cast<uint8_t>(high << 4 | low);
+            }
+            out.bytes = parsed;
+            return true;
+        }
+
+        // The null ID if text is not canonical
+        static BasicId fromHex(std::string_view text) {
+            BasicId id;
+            parse(text, id);
+            return id;
+        }
+
+        bool isNull() const { return *this == BasicId(); }
+        const uint8_t* data() const { return bytes.data(); }
+
+        // Writes the kHexLength digits to out, without a terminator
+        void toHex(char* out) const {
+            static const char digits[] = "0123456789abcdef";
+            for (size_t i = 0; i < kSize; ++i) {
+                out[2 * i] = digits[bytes[i] >> 4];
+                out[2 * i + 1] = digits[bytes[i] & 0xF];
+            }
+        }
+
+        std::string toHex() const {
+            std::string text(kHexLength, '\0');
+            toHex(&text[0]);
+            return text;
+        }
+
+        // Content-hash IDs are random throughout, but time-ordered ones keep the
+        // timestamp and counter in the high half; the spread comes from the 62 random
+        // bits of the low half, which the multiply carries into every bit
+        size_t hash() const {
+            uint64_t high, low;
+            std::memcpy(&high, bytes.data(), 8);
+            std::memcpy(&low, bytes.data() + 8, 8);
+            return static_cast<size_t>(high ^ (low * 0x9e3779b97f4a7c15ULL));
+        }
+
+        friend bool operator==(const BasicId& a, const BasicId& b) { return a.bytes == b.bytes; }
+        friend bool operator!=(const BasicId& a, const BasicId& b) { return a.bytes != b.bytes; }
+        friend bool operator<(const BasicId& a, const BasicId& b) { return a.bytes < b.bytes; }
+        friend bool operator>(const BasicId& a, const BasicId& b) { return b.bytes < a.bytes; }
+        friend bool operator<=(const BasicId& a, const BasicId& b) { return !(b.bytes < a.bytes); }
+        friend bool operator>=(const BasicId& a, const BasicId& b) { return !(a.bytes < b.bytes); }
+
+    private:
+        static int nibble(char c) {
+            return c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        }
+
+        std::array<uint8_t, kSize> bytes{};
+    };
+
+    using BookId = BasicId<struct BookIdTag>;
+    using UserId = BasicId<struct UserIdTag>;
+}
+
+namespace std {
+    template <typename Tag>
+    struct hash<lms::BasicId<Tag>> {
+        size_t operator()(const lms::BasicId<Tag>& id) const noexcept { return id.hash(); }
+    };
+}
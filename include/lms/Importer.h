@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include "Database.h"
+
+namespace lms {
+    enum class ImportKind { Books, Users };
+    enum class ImportFormat { Csv, JsonLines };
+
+    // Counters of a running or finished import
+    struct ImportProgress {
+        uint64_t bytesRead = 0;
+        uint64_t totalBytes = 0;
+        uint64_t rowsParsed = 0;
+        uint64_t rowsInserted = 0;
+        uint64_t rowsMalformed = 0;     // Records that could not be parsed or had no name
+        uint64_t rowsRejected = 0;      // Parsed rows the database refused, e.g. duplicate IDs
+        double elapsedSeconds = 0.0;
+
+        double rowsPerSecond() const { return elapsedSeconds > 0 ? rowsInserted / elapsedSeconds : 0.0; }
+        double megabytesPerSecond() const { return elapsedSeconds > 0 ? bytesRead / elapsedSeconds / (1024.0 * 1024.0) : 0.0; }
+    };
+
+    struct ImportOptions {
+        ImportKind kind = ImportKind::Books;
+        ImportFormat format = ImportFormat::Csv;
+        // CSV only: the first line names the columns. Without it the columns are
+        // name,author,year,tags for books and name,email,dob,address for users.
+        bool csvHeader = true;
+        size_t parserThreads = 0;                   // 0 picks one per hardware thread
+        size_t chunkBytes = 4 << 20;                // Input is read and parsed in chunks of about this size
+        size_t batchSize = 5000;                    // Rows per writer transaction
+        IdStrategy idStrategy = IdStrategy::ContentHash;    // For rows without an id
+        double progressInterval = 1.0;              // Seconds between onProgress calls
+        std::function<void(const ImportProgress&)> onProgress;
+    };
+
+    // Bulk loader for CSV or JSON Lines dumps. The input is streamed in chunks cut at
+    // record boundaries; parser threads turn chunks into Books or Users (generating
+    // IDs in parallel), and the calling thread inserts them through Database::addBooks
+    // / addUsers in batched transactions. Queues between the stages are bounded, so
+    // memory stays flat however large the file is.
+    //
+    // Recognized columns / keys: id, name (or title), author, year, tags for books
+    // and id, name, email, dob, address, is_active for users; anything else is
+    // ignored. Tags are separated by ';' in CSV, where a backslash makes a following
+    // ';' or backslash literal, and may be a string array in JSON.
+    // Rows without an id get one generated with options.idStrategy.
+    class Importer {
+    public:
+        Importer(Database& db, const ImportOptions& options);
+
+        // Returns false if the file could not be read; progress() has the totals
+        bool run(const std::string& path);
+        const ImportProgress& progress() const { return totals; }
+
+    private:
+        Database& db;
+        ImportOptions options;
+        ImportProgress totals;
+    };
+}
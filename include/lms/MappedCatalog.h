@@ -0,0 +1,73 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Book.h"
+
+namespace lms {
+    class Database;
+
+    // Read-only book catalog stored in one file that is memory-mapped and used in
+    // place: opening it only validates the header, and every lookup binary-searches
+    // the mapped pages, so startup costs the same for ten books or ten million.
+    // Written by MappedCatalog::write (the `lms snapshot` command).
+    //
+    // Layout (little-endian, sections 8-byte aligned, string refs are heap offset +
+    // length):
+    //   header       magic "LMSS", version, byte-order mark, ID width, counts and
+    //                the offset of every section
+    //   ids          bookCount fixed-width slots, zero padded, sorted; a book's
+    //                position here is its ordinal everywhere else
+    //   records      per book: name, author, year, currentUser, tags (joined by
+    //                kTagSeparator)
+    //   authors      book ordinals sorted by (author, ID)
+    //   tags         per distinct tag, sorted: name, first posting, posting count
+    //   postings     book ordinals per tag, ascending
+    //   heap         the string bytes, each distinct string stored once
+    class MappedCatalog {
+    public:
+        static constexpr uint32_t kVersion = 1;
+
+        MappedCatalog() = default;
+        ~MappedCatalog();
+        MappedCatalog(const MappedCatalog&) = delete;
+        MappedCatalog& operator=(const MappedCatalog&) = delete;
+
+        // Writes every book of db to path (through a temporary file renamed over path,
+        // so processes that have the old file open keep a consistent copy)
+        static bool write(const Database& db, const std::string& path);
+
+        bool open(const std::string& path);
+        void close();
+        bool isOpen() const { return base != nullptr; }
+
+        // All views point into the mapping and stay valid until close()
+        size_t bookCount() const;
+        BookView bookAt(size_t ordinal) const;
+        bool findBook(std::string_view bookID, BookView& out) const;
+        // Books in ID order; a negative limit returns every match
+        std::vector<BookView> findBooksByAuthor(std::string_view author, int limit = -1) const;
+        std::vector<BookView> findBooksByTag(std::string_view tag, int limit = -1) const;
+
+    private:
+        struct Header;
+        struct StringRef;
+        struct BookRecord;
+        struct TagEntry;
+
+        std::string_view text(const StringRef& ref) const;
+        std::string_view idAt(size_t ordinal) const;
+
+        const char* base = nullptr;
+        size_t size = 0;
+        const Header* header = nullptr;
+#ifdef _WIN32
+        void* fileHandle = nullptr;
+        void* mappingHandle = nullptr;
+#else
+        int fd = -1;
+#endif
+    };
+}
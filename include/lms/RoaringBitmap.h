@@ -0,0 +1,102 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace lms {
+    // Compressed set of 32-bit integers in the Roaring layout: values are grouped by
+    // their high 16 bits, and each group is held either as a sorted array of the low
+    // 16 bits (up to 4096 values) or as a 65536-bit bitmap, whichever is smaller.
+    // Sparse sets cost about two bytes per value and dense ones one bit, and set
+    // operations work a group at a time: bitmap groups are combined 256 bits per
+    // instruction with AVX2 when the CPU has it, arrays by merging.
+    class RoaringBitmap {
+    public:
+        void add(uint32_t value);
+        // Returns false if value was not in the set
+        bool remove(uint32_t value);
+        bool contains(uint32_t value) const;
+        void clear() { containers.clear(); }
+
+        bool empty() const { return containers.empty(); }
+        uint64_t cardinality() const;
+        size_t memoryUsage() const;
+
+        // Calls fn(uint32_t) for every value in ascending order until it returns false
+        template <typename Fn>
+        void forEach(Fn fn) const {
+            for (const auto& container : containers) {
+                uint32_t high = static_cast<uint32_t>(container.key) << 16;
+                if (container.isBitmap()) {
+                    for (size_t word = 0; word < kBitmapWords; ++word) {
+                        for (uint64_t bits = container.bits[word]; bits; bits &= bits - 1)
+                            if (!fn(high | static_cast<uint32_t>(word * 64 + countTrailingZeros(bits)))) return;
+                    }
+                } else {
+                    for (uint16_t low : container.values)
+                        if (!fn(high | low)) return;
+                }
+            }
+        }
+        std::vector<uint32_t> toVector() const;
+
+        // Set algebra; the operands are left untouched, so posting lists can be
+        // combined without copying them first
+        friend RoaringBitmap operator&(const RoaringBitmap& a, const RoaringBitmap& b);
+        friend RoaringBitmap operator|(const RoaringBitmap& a, const RoaringBitmap& b);
+        friend RoaringBitmap operator-(const RoaringBitmap& a, const RoaringBitmap& b);  // AND NOT
+        RoaringBitmap& operator&=(const RoaringBitmap& other) { return *this = *this & other; }
+        RoaringBitmap& operator|=(const RoaringBitmap& other) { return *this = *this | other; }
+        RoaringBitmap& operator-=(const RoaringBitmap& other) { return *this = *this - other; }
+
+        friend bool operator==(const RoaringBitmap& a, const RoaringBitmap& b);
+        friend bool operator!=(const RoaringBitmap& a, const RoaringBitmap& b) { return !(a == b); }
+
+        // Whether set operations use the AVX2 kernels. useSimd overrides the automatic
+        // choice, e.g. to compare kernels; it returns false (changing nothing) when
+        // enabling SIMD on a CPU or build without it. Not thread-safe: call before
+        // any set operations run.
+        static bool useSimd(bool enabled);
+        static bool usingSimd();
+
+    private:
+        static constexpr size_t kMaxArraySize = 4096;
+        static constexpr size_t kBitmapWords = 65536 / 64;
+
+        // One group of values sharing the high 16 bits: values (sorted) while it has
+        // at most kMaxArraySize of them, bits (kBitmapWords words) above that
+        struct Container {
+            uint16_t key = 0;
+            uint32_t count = 0;
+            std::vector<uint16_t> values;
+            std::vector<uint64_t> bits;
+
+            bool isBitmap() const { return !bits.empty(); }
+            bool contains(uint16_t low) const;
+            // Switches to whichever representation suits count
+            void normalize();
+        };
+
+        static int countTrailingZeros(uint64_t bits) {
+#if defined(_MSC_VER)
+            unsigned long index;
+            _BitScanForward64(&index, bits);
+            return static_cast<int>(index);
+#else
+            return __builtin_ctzll(bits);
+#endif
+        }
+
+        static Container intersect(const Container& a, const Container& b);
+        static Container unite(const Container& a, const Container& b);
+        static Container subtract(const Container& a, const Container& b);
+
+        // Index of the container for key, or of where it would be inserted
+        size_t lowerBound(uint16_t key) const;
+
+        std::vector<Container> containers;     // Sorted by key, none empty
+    };
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace lms {
+    // SHA-256 for ID generation, with the implementation picked once from the CPU:
+    // the SHA extensions (SHA-NI) for single messages, and eight messages at a time
+    // in AVX2 registers for hashMany. Everything else falls back to a portable
+    // version. Every backend produces the same digests as picosha2.
+    namespace sha256 {
+        using Digest = std::array<uint8_t, 32>;
+
+        enum class Backend { Portable, ShaNi, Avx2 };
+
+        Digest hash(std::string_view data);
+        // out[i] = hash(inputs[i]); batches short messages through the multi-buffer path
+        void hashMany(const std::string_view* inputs, size_t count, Digest* out);
+
+        // Lowercase hex of size bytes written to out (2 * size chars, no terminator)
+        void toHex(const uint8_t* bytes, size_t size, char* out);
+        std::string toHex(const uint8_t* bytes, size_t size);
+
+        // Backends in use for hash and hashMany
+        Backend singleBackend();
+        Backend batchBackend();
+        const char* backendName(Backend backend);
+        // Overrides the automatic choice, e.g. to compare backends; returns false
+        // (changing nothing) if this CPU or build does not support the backend.
+        // Not thread-safe: call before hashing starts.
+        bool useBackends(Backend single, Backend batch);
+    }
+}
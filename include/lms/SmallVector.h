@@ -0,0 +1,96 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace lms {
+    // Vector of trivially copyable values that keeps up to N of them inline and
+    // only allocates once it grows past N. Sized for short lists such as a book's
+    // tag handles, where N covers almost every row.
+    template <typename T, size_t N>
+    class SmallVector {
+        static_assert(std::is_trivially_copyable<T>::value, "SmallVector copies its elements with memcpy");
+
+    public:
+        SmallVector() = default;
+        SmallVector(const SmallVector& other) { assign(other.begin(), other.size()); }
+        SmallVector(SmallVector&& other) noexcept { steal(other); }
+        ~SmallVector() { release(); }
+
+        SmallVector& operator=(const SmallVector& other) {
+            if (this != &other) {
+                count = 0;
+                assign(other.begin(), other.size());
+            }
+            return *this;
+        }
+
+        SmallVector& operator=(SmallVector&& other) noexcept {
+            if (this != &other) {
+                release();
+                steal(other);
+            }
+            return *this;
+        }
+
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        bool isInline() const { return capacity == N; }
+
+        T* begin() { return isInline() ? local : heap; }
+        T* end() { return begin() + count; }
+        const T* begin() const { return isInline() ? local : heap; }
+        const T* end() const { return begin() + count; }
+        T& operator[](size_t i) { return begin()[i]; }
+        const T& operator[](size_t i) const { return begin()[i]; }
+
+        void push_back(const T& value) {
+            if (count == capacity) reserve(static_cast<size_t>(capacity) * 2);
+            begin()[count++] = value;
+        }
+
+        void reserve(size_t wanted) {
+            if (wanted <= capacity) return;
+            T* grown = new T[wanted];
+            std::memcpy(grown, begin(), count * sizeof(T));
+            release();
+            heap = grown;
+            capacity = static_cast<uint32_t>(wanted);
+        }
+
+        void clear() { count = 0; }
+
+    private:
+        void assign(const T* values, size_t size) {
+            reserve(size);
+            std::memcpy(begin(), values, size * sizeof(T));
+            count = static_cast<uint32_t>(size);
+        }
+
+        void steal(SmallVector& other) {
+            if (other.isInline()) {
+                std::memcpy(local, other.local, other.count * sizeof(T));
+            } else {
+                heap = other.heap;
+                capacity = other.capacity;
+                other.capacity = N;
+            }
+            count = other.count;
+            other.count = 0;
+        }
+
+        void release() {
+            if (!isInline()) delete[] heap;
+            capacity = N;
+        }
+
+        union {
+            T local[N];
+            T* heap;
+        };
+        uint32_t count = 0;
+        uint32_t capacity = N;
+    };
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace lms {
+    // Interns strings that repeat across many rows (authors, years, tags) and hands
+    // out 4-byte handles for them. Every distinct string is stored once, in chunks
+    // that never move, so views stay valid for the pool's lifetime. Strings are
+    // never removed: the pool grows with the number of distinct values seen, not
+    // with the number of rows. Thread-safe.
+    class StringPool {
+    public:
+        using Handle = uint32_t;
+        static constexpr Handle kEmpty = 0;     // Always the empty string
+
+        StringPool();
+        StringPool(const StringPool&) = delete;
+        StringPool& operator=(const StringPool&) = delete;
+
+        // The handle of text, adding it on first use
+        Handle intern(std::string_view text);
+        // Looks text up without adding it; false if it was never interned
+        bool find(std::string_view text, Handle& out) const;
+        std::string_view view(Handle handle) const;
+
+        size_t size() const;            // Distinct strings, including ""
+        size_t memoryUsage() const;     // Bytes held by chunks and the lookup tables
+
+    private:
+        static constexpr size_t kChunkSize = 64 * 1024;
+
+        const char* store(std::string_view text);
+
+        mutable std::shared_mutex mutex;
+        std::vector<std::unique_ptr<char[]>> chunks;
+        std::vector<std::unique_ptr<char[]>> large;
+        size_t chunkBytes = 0;
+        size_t chunkUsed = kChunkSize;  // Of the last chunk; full until the first store
+        std::vector<std::string_view> strings;
+        std::unordered_map<std::string_view, Handle> index;
+    };
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "Id.h"
+#include "RoaringBitmap.h"
+#include "SmallVector.h"
+
+namespace lms {
+    // A boolean expression over tags, e.g. `fantasy AND young-adult NOT horror`.
+    //
+    //   query := and { OR and }
+    //   and   := unary { [AND] unary | NOT unary }     (adjacent terms are ANDed;
+    //                                                  a NOT b means a AND NOT b)
+    //   unary := NOT unary | ( query ) | tag
+    //
+    // Keywords are upper case; tags are any other run of characters up to a space or
+    // parenthesis, or a "double-quoted" string (for tags with spaces, or a tag named
+    // like a keyword).
+    class TagQuery {
+    public:
+        TagQuery();
+        ~TagQuery();
+        TagQuery(TagQuery&&) noexcept;
+        TagQuery& operator=(TagQuery&&) noexcept;
+
+        // Fills out and returns true if text is a valid query; otherwise error says why
+        static bool parse(std::string_view text, TagQuery& out, std::string* error = nullptr);
+
+        // Evaluates the query against one book's tags, joined by kTagSeparator (the
+        // BookView::tags form)
+        bool matches(std::string_view tags) const;
+
+        // Syntax tree node, defined in TagIndex.cpp
+        struct Node;
+
+    private:
+        friend class TagIndex;
+        std::unique_ptr<Node> root;
+    };
+
+    // In-memory inverted index from tag to the set of books carrying it, for tag
+    // queries that combine many tags. Every book gets a dense ordinal (freed
+    // ordinals are reused), and every tag a RoaringBitmap of ordinals, so a query
+    // is a handful of bitmap operations however many books match. Database keeps
+    // it in step with its writes (see Database::enableTagIndex). Thread-safe;
+    // queries run in parallel with each other.
+    class TagIndex {
+    public:
+        // Replaces the tags of bookID, adding the book if it is new. tags are joined
+        // by kTagSeparator, as in BookView::tags.
+        void setBook(std::string_view bookID, std::string_view tags);
+        void removeBook(std::string_view bookID);
+        void clear();
+
+        // Ordinals of the books matching query
+        RoaringBitmap match(const TagQuery& query) const;
+        uint64_t count(const TagQuery& query) const;
+        // IDs of the books matching query, in ID order; a negative limit returns
+        // every match
+        std::vector<std::string> findBooks(const TagQuery& query, int limit = -1) const;
+
+        size_t bookCount() const;
+        size_t tagCount() const;
+        size_t memoryUsage() const;    // Bitmaps only, in bytes
+
+    private:
+        RoaringBitmap evaluate(const TagQuery::Node& node) const;
+        const RoaringBitmap* postingsFor(const std::string& tag) const;
+        // Caller holds the lock exclusively
+        bool findOrdinal(std::string_view bookID, uint32_t& ordinal) const;
+        uint32_t addOrdinal(std::string_view bookID);
+        std::string idAt(uint32_t ordinal) const;
+
+        mutable std::shared_mutex mutex;
+        // Canonical IDs are keyed by value; custom IDs by their text
+        std::unordered_map<BookId, uint32_t> canonicalOrdinals;
+        std::unordered_map<std::string, uint32_t> customOrdinals;
+        std::vector<BookId> ids;                        // By ordinal; null for custom IDs
+        std::unordered_map<uint32_t, std::string> customIds;
+        std::vector<uint32_t> freeOrdinals;
+        std::vector<SmallVector<uint32_t, 4>> bookTags; // Tag numbers by ordinal
+        RoaringBitmap books;                            // Every live ordinal
+
+        std::unordered_map<std::string, uint32_t> tagNumbers;
+        std::vector<RoaringBitmap> postings;            // By tag number
+    };
+}
@@ -0,0 +1,291 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace lms {
+    // Counters for a TinyLfuCache
+    struct CacheStats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        uint64_t rejections = 0;    // Candidates refused by the admission policy
+        size_t size = 0;
+        size_t capacity = 0;
+        size_t sharedBytes = 0;     // Memory shared by the entries outside the cache (see Database)
+
+        double hitRate() const {
+            uint64_t lookups = hits + misses;
+            return lookups ? static_cast<double>(hits) / lookups : 0.0;
+        }
+    };
+
+    // Bounded in-memory cache with W-TinyLFU admission: new entries land in a small
+    // LRU window, and an entry leaving the window only displaces a main-area entry
+    // if a Count-Min sketch says it is accessed more often. The main area is a
+    // segmented LRU (probation / protected). The cache is split into independently
+    // locked shards so lookups from many threads do not contend on one mutex.
+    template <typename Key, typename Value, typename Hash = std::hash<Key>>
+    class TinyLfuCache {
+    public:
+        explicit TinyLfuCache(size_t capacity, size_t shardCount = 16) {
+            shardCount = std::max<size_t>(1, std::min(shardCount, capacity / 64 + 1));
+            size_t perShard = std::max<size_t>(1, (capacity + shardCount - 1) / shardCount);
+            for (size_t i = 0; i < shardCount; ++i)
+                shards.push_back(std::make_unique<Shard>(perShard));
+        }
+
+        // Copies the cached value into out and records the access
+        bool get(const Key& key, Value& out) {
+            uint64_t hash = mix(Hash()(key));
+            Shard& shard = shardFor(hash);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.sketch.increment(hash);
+            auto it = shard.index.find(key);
+            if (it == shard.index.end()) {
+                ++shard.stats.misses;
+                return false;
+            }
+            ++shard.stats.hits;
+            shard.touch(it->second);
+            out = it->second->value;
+            return true;
+        }
+
+        // Like get, but calls read(const Value&) under the shard lock instead of
+        // copying, for values that are converted on the way out
+        template <typename Reader>
+        bool read(const Key& key, Reader read) {
+            uint64_t hash = mix(Hash()(key));
+            Shard& shard = shardFor(hash);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.sketch.increment(hash);
+            auto it = shard.index.find(key);
+            if (it == shard.index.end()) {
+                ++shard.stats.misses;
+                return false;
+            }
+            ++shard.stats.hits;
+            shard.touch(it->second);
+            read(it->second->value);
+            return true;
+        }
+
+        // Inserts or replaces key; a new key may be rejected by the admission policy
+        void put(const Key& key, const Value& value) {
+            putIf(key, value, [] { return true; });
+        }
+
+        // Like put, but only if stillValid() holds once the shard is locked. Lets a
+        // loader drop a value that an erase() raced with while it was being read.
+        // Values passed as rvalues are moved into the cache.
+        template <typename V, typename Predicate>
+        void putIf(const Key& key, V&& value, Predicate stillValid) {
+            uint64_t hash = mix(Hash()(key));
+            Shard& shard = shardFor(hash);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            if (!stillValid()) return;
+            auto it = shard.index.find(key);
+            if (it != shard.index.end()) {
+                it->second->value = std::forward<V>(value);
+                shard.touch(it->second);
+                return;
+            }
+            shard.insert(key, std::forward<V>(value), hash);
+        }
+
+        void erase(const Key& key) {
+            uint64_t hash = mix(Hash()(key));
+            Shard& shard = shardFor(hash);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.index.find(key);
+            if (it == shard.index.end()) return;
+            shard.unlink(it->second);
+            shard.index.erase(it);
+        }
+
+        void clear() {
+            for (auto& shard : shards) {
+                std::lock_guard<std::mutex> lock(shard->mutex);
+                shard->window.clear();
+                shard->probation.clear();
+                shard->protectedList.clear();
+                shard->index.clear();
+            }
+        }
+
+        // Calls fn(Value&) for every cached value, one shard at a time under its lock
+        template <typename Fn>
+        void forEachValue(Fn fn) {
+            for (auto& shard : shards) {
+                std::lock_guard<std::mutex> lock(shard->mutex);
+                for (List* list : {&shard->window, &shard->probation, &shard->protectedList})
+                    for (Entry& entry : *list) fn(entry.value);
+            }
+        }
+
+        CacheStats stats() const {
+            CacheStats total;
+            for (const auto& shard : shards) {
+                std::lock_guard<std::mutex> lock(shard->mutex);
+                total.hits += shard->stats.hits;
+                total.misses += shard->stats.misses;
+                total.evictions += shard->stats.evictions;
+                total.rejections += shard->stats.rejections;
+                total.size += shard->index.size();
+                total.capacity += shard->windowCapacity + shard->probationCapacity + shard->protectedCapacity;
+            }
+            return total;
+        }
+
+    private:
+        enum class Segment : uint8_t { Window, Probation, Protected };
+
+        struct Entry {
+            Key key;
+            Value value;
+            uint64_t hash;
+            Segment segment;
+        };
+        using List = std::list<Entry>;
+        using Iterator = typename List::iterator;
+
+        // Count-Min sketch of 4 rows of 4-bit-style saturating counters. All counters
+        // are halved every sampleSize increments so old popularity fades out.
+        class FrequencySketch {
+        public:
+            explicit FrequencySketch(size_t capacity) {
+                size_t width = 16;
+                while (width < capacity * 2) width <<= 1;
+                mask = width - 1;
+                counters.assign(width * 4, 0);
+                sampleSize = std::max<size_t>(10 * capacity, 16);
+            }
+            void increment(uint64_t hash) {
+                for (size_t row = 0; row < 4; ++row) {
+                    uint8_t& counter = counters[row * (mask + 1) + slot(hash, row)];
+                    if (counter < 15) ++counter;
+                }
+                if (++samples >= sampleSize) {
+                    for (auto& counter : counters) counter >>= 1;
+                    samples /= 2;
+                }
+            }
+            uint8_t estimate(uint64_t hash) const {
+                uint8_t result = 15;
+                for (size_t row = 0; row < 4; ++row)
+                    result = std::min(result, counters[row * (mask + 1) + slot(hash, row)]);
+                return result;
+            }
+        private:
+            size_t slot(uint64_t hash, size_t row) const {
+                return static_cast<size_t>((hash >> (row * 16)) ^ (hash >> (row * 16 + 32))) & mask;
+            }
+            std::vector<uint8_t> counters;
+            size_t mask = 0;
+            size_t samples = 0;
+            size_t sampleSize = 0;
+        };
+
+        struct Shard {
+            explicit Shard(size_t capacity)
+                : windowCapacity(std::max<size_t>(1, capacity / 100)),
+                  probationCapacity(0),
+                  protectedCapacity(0),
+                  sketch(capacity) {
+                size_t mainCapacity = capacity > windowCapacity ? capacity - windowCapacity : 1;
+                protectedCapacity = mainCapacity * 4 / 5;
+                probationCapacity = mainCapacity - protectedCapacity;
+            }
+
+            List& listFor(Segment segment) {
+                switch (segment) {
+                    case Segment::Window: return window;
+                    case Segment::Probation: return probation;
+                    default: return protectedList;
+                }
+            }
+
+            void unlink(Iterator entry) {
+                listFor(entry->segment).erase(entry);
+            }
+
+            // Records a hit: window and protected entries move to the front, probation
+            // entries are promoted to protected
+            void touch(Iterator entry) {
+                if (entry->segment != Segment::Probation) {
+                    List& list = listFor(entry->segment);
+                    list.splice(list.begin(), list, entry);
+                    return;
+                }
+                entry->segment = Segment::Protected;
+                protectedList.splice(protectedList.begin(), probation, entry);
+                if (protectedList.size() > protectedCapacity) {
+                    auto demoted = std::prev(protectedList.end());
+                    demoted->segment = Segment::Probation;
+                    probation.splice(probation.begin(), protectedList, demoted);
+                }
+            }
+
+            template <typename V>
+            void insert(const Key& key, V&& value, uint64_t hash) {
+                window.push_front(Entry{key, std::forward<V>(value), hash, Segment::Window});
+                index.emplace(key, window.begin());
+                if (window.size() <= windowCapacity) return;
+
+                // The window overflowed: its LRU entry becomes a candidate for the main area
+                auto candidate = std::prev(window.end());
+                if (probation.size() + protectedList.size() < probationCapacity + protectedCapacity) {
+                    candidate->segment = Segment::Probation;
+                    probation.splice(probation.begin(), window, candidate);
+                    return;
+                }
+                List& victims = probation.empty() ? protectedList : probation;
+                auto victim = std::prev(victims.end());
+                if (sketch.estimate(candidate->hash) > sketch.estimate(victim->hash)) {
+                    index.erase(victim->key);
+                    victims.erase(victim);
+                    ++stats.evictions;
+                    candidate->segment = Segment::Probation;
+                    probation.splice(probation.begin(), window, candidate);
+                } else {
+                    index.erase(candidate->key);
+                    window.erase(candidate);
+                    ++stats.rejections;
+                }
+            }
+
+            size_t windowCapacity;
+            size_t probationCapacity;
+            size_t protectedCapacity;
+            List window;
+            List probation;
+            List protectedList;
+            std::unordered_map<Key, Iterator, Hash> index;
+            FrequencySketch sketch;
+            CacheStats stats;
+            mutable std::mutex mutex;
+        };
+
+        // Spreads weak std::hash values (often the identity) over all 64 bits
+        static uint64_t mix(uint64_t x) {
+            x ^= x >> 30;
+            x *= 0xbf58476d1ce4e5b9ULL;
+            x ^= x >> 27;
+            x *= 0x94d049bb133111ebULL;
+            return x ^ (x >> 31);
+        }
+
+        Shard& shardFor(uint64_t hash) {
+            return *shards[static_cast<size_t>(hash >> 56) % shards.size()];
+        }
+
+        std::vector<std::unique_ptr<Shard>> shards;
+    };
+}
@@ -1,48 +1,91 @@
 #pragma once
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
-#include "../utils/picosha2.h"
+#include "Id.h"
 
 namespace lms {
 
 class Database; // Forward declaration for Database class
 
+// Read-only, non-owning view of a user row, valid only during the callback that
+// received it (see BookView)
+struct UserView {
+    std::string_view userID;
+    std::string_view name;
+    std::string_view email;
+    std::string_view dob;
+    std::string_view address;
+    std::string_view borrowedBooks;                 // Book IDs joined by ','
+    bool isActive = true;
+};
+
 class User {
+public:
+    // Bits of dirtyFields(), one per column updateUser writes (borrowed books live
+    // in the loans table)
+    enum Field : uint8_t {
+        NameField       = 1 << 0,
+        EmailField      = 1 << 1,
+        DobField        = 1 << 2,
+        AddressField    = 1 << 3,
+        ActiveField     = 1 << 4,
+        AllFields       = (1 << 5) - 1
+    };
+
 private:
     std::string userID                      = ""; 
     std::string name                        = "";  
     std::string email                       = ""; 
     std::string dob                         = ""; 
     std::string address                     = ""; 
-    std::vector<std::string> borrowedBooks  = {}; // List of bookIDs
+    std::vector<BookId> borrowedBooks       = {}; // Borrowed books with canonical IDs
+    std::vector<std::string> customBorrowed = {}; // The rest, by their text IDs (rarely any)
     bool isActive                           = true;
+    uint8_t dirty                           = AllFields;    // Fields set since the user was loaded
 
 public:
     User(const User&) = default; // Copy constructor
     User& operator=(const User&) = default; // Copy assignment operator
-    User(const std::string& name = "", const std::string& email = "", const std::string& dob = "", const std::string& address = "");
-
-    // Getters
-    std::string getUserID() const;
-    std::string getName() const;
-    std::string getEmail() const;
-    std::string getDOB() const;
-    std::string getAddress() const;
+    User(std::string name = "", std::string email = "", std::string dob = "", std::string address = "");
+
+    // Getters return references into the user, valid until it is modified or destroyed
+    const std::string& getUserID() const { return userID; }
+    UserId getID() const;                           // Null if the ID is not canonical hex
+    const std::string& getName() const { return name; }
+    const std::string& getEmail() const { return email; }
+    const std::string& getDOB() const { return dob; }
+    const std::string& getAddress() const { return address; }
+    // Borrowed books with canonical IDs, as a flat array of 16-byte values, and those
+    // with custom IDs
+    const std::vector<BookId>& getBorrowedBookIDs() const { return borrowedBooks; }
+    const std::vector<std::string>& getCustomBorrowedBooks() const { return customBorrowed; }
+    // Every borrowed book ID as text, canonical ones first; built on each call
     std::vector<std::string> getBorrowedBooks() const;
-    bool active() const;
-
-    // Setters
-    void setUserID(const std::string& _userID);
-    void setName(const std::string& _name);
-    void setEmail(const std::string& _email);
-    void setDOB(const std::string& _dob);
-    void setAddress(const std::string& _address);
+    size_t borrowedCount() const { return borrowedBooks.size() + customBorrowed.size(); }
+    bool active() const { return isActive; }
+
+    // Setters take their argument by value, so callers can move into them
+    void setUserID(std::string _userID);
+    void setID(const UserId& _userID);
+    void setName(std::string _name);
+    void setEmail(std::string _email);
+    void setDOB(std::string _dob);
+    void setAddress(std::string _address);
     void setBorrowedBooks(const std::vector<std::string>& books);
+    void setBorrowedBooks(std::vector<BookId> books, std::vector<std::string> customBooks = {});
     void setActive(bool status);
 
+    // Fields changed since the user was read from the database (every field for a
+    // user built in memory); updateUser writes only these
+    uint8_t dirtyFields() const { return dirty; }
+    void markClean() { dirty = 0; }
+
     // Book management (in-memory only)
     void addBorrowedBook(const std::string& bookID);
     void removeBorrowedBook(const std::string& bookID);
+    bool hasBorrowed(const std::string& bookID) const;
 
     // Book management (with database sync)
     bool borrowBookDB(const std::string& bookID, Database& db);
@@ -50,6 +93,9 @@ public:
 
     // ID generation
     std::string generateID() const;
+    std::string generateID(IdStrategy strategy) const;
+    // Gives every user without an ID a generated one; content hashes are computed in batches
+    static void generateIDs(std::vector<User>& users, IdStrategy strategy = IdStrategy::ContentHash);
 
     // Update this user's data in the database
     bool updateInDB(Database& db) const;
@@ -1,27 +1,23 @@
 #include "../include/lms/User.h"
 #include "../include/lms/Book.h"
 #include "../include/lms/Database.h"
+#include "../include/lms/Sha256.h"
 #include <algorithm>
 
 namespace lms {
-    Book::Book(const std::string& name, const std::string& author, const std::string& year)
-        : name(name), author(author), year(year), isAvailable(true) {}
+    Book::Book(std::string name, std::string author, std::string year)
+        : name(std::move(name)), author(std::move(author)), year(std::move(year)), isAvailable(true) {}
 
-    std::string Book::getBookID() const { return bookID; }
-    std::string Book::getBookName() const { return name; }
-    std::string Book::getAuthor() const { return author; }
-    std::string Book::getCurrentUser() const { return currentUser; }
-    std::string Book::getPublicationYear() const { return year; }
-    std::vector<std::string> Book::getTags() const { return tags; }
-    bool Book::available() const { return isAvailable; }
+    BookId Book::getID() const { return BookId::fromHex(bookID); }
 
-    void Book::setBookID(const std::string& _bookID) { bookID = _bookID; }
-    void Book::setBookName(const std::string& _name) { name = _name; }
-    void Book::setAuthor(const std::string& _author) { author = _author; }
-    void Book::setCurrentUser(const std::string& _currentUser) { currentUser = _currentUser; }
-    void Book::setPublicationYear(const std::string& _year) { year = _year; }
-    void Book::addTag(const std::string& _tag) { tags.push_back(_tag); }
-    void Book::setTags(const std::vector<std::string>& _tags) { tags = _tags; }
+    void Book::setBookID(std::string _bookID) { bookID = std::move(_bookID); }
+    void Book::setID(const BookId& _bookID) { bookID = _bookID.toHex(); }
+    void Book::setBookName(std::string _name) { name = std::move(_name); dirty |= NameField; }
+    void Book::setAuthor(std::string _author) { author = std::move(_author); dirty |= AuthorField; }
+    void Book::setCurrentUser(std::string _currentUser) { currentUser = std::move(_currentUser); dirty |= CurrentUserField; }
+    void Book::setPublicationYear(std::string _year) { year = std::move(_year); dirty |= YearField; }
+    void Book::addTag(std::string _tag) { tags.push_back(std::move(_tag)); dirty |= TagsField; }
+    void Book::setTags(std::vector<std::string> _tags) { tags = std::move(_tags); dirty |= TagsField; }
     void Book::setAvailable(bool _status) { isAvailable = _status; }
 
     bool Book::updateInDB(Database& db) const {
@@ -30,7 +26,35 @@ namespace lms {
 
     std::string Book::generateID() const {
         std::string data = name + author + year;
-        std::string hash = picosha2::hash256_hex_string(data);
-        return hash.substr(0, 32); // 16 bytes (32 hex chars)
+        sha256::Digest hash = sha256::hash(data);
+        return sha256::toHex(hash.data(), 16); // 16 bytes (32 hex chars)
+    }
+
+    std::string Book::generateID(IdStrategy strategy) const {
+        return strategy == IdStrategy::TimeOrdered ? BookId::timeOrdered().toHex() : generateID();
+    }
+
+    void Book::generateIDs(std::vector<Book>& books, IdStrategy strategy) {
+        std::vector<size_t> pending;
+        std::vector<std::string> data;
+        for (size_t i = 0; i < books.size(); ++i) {
+            if (!books[i].bookID.empty()) continue;
+            pending.push_back(i);
+            data.push_back(books[i].name + books[i].author + books[i].year);
+        }
+        std::vector<std::string_view> inputs(data.begin(), data.end());
+        std::vector<sha256::Digest> hashes(inputs.size());
+        sha256::hashMany(inputs.data(), inputs.size(), hashes.data());
+        if (strategy == IdStrategy::TimeOrdered) {
+            // Hand out the increasing IDs in content hash order, so a batch inserted in
+            // ID order also fills the content_hash index in order
+            std::vector<size_t> order(pending.size());
+            for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+            std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return hashes[a] < hashes[b]; });
+            for (size_t i : order) books[pending[i]].bookID = BookId::timeOrdered().toHex();
+            return;
+        }
+        for (size_t i = 0; i < pending.size(); ++i)
+            books[pending[i]].bookID = sha256::toHex(hashes[i].data(), 16);
     }
 } // namespace lms
@@ -0,0 +1,123 @@
+#include "../include/lms/CatalogSnapshot.h"
+#include <algorithm>
+#include <cctype>
+
+namespace lms {
+    namespace {
+        // Each mirror gets a distinct ID so the per-thread cache in current() can
+        // tell mirrors apart even if one is destroyed and another takes its address
+        std::atomic<uint64_t> nextMirrorID{1};
+
+        bool containsIgnoreCase(const std::string& haystack, const std::string& needle) {
+            auto it = std::search(haystack.begin(), haystack.end(), needle.begin(), needle.end(), [](char a, char b) {
+                return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+            });
+            return it != haystack.end() || needle.empty();
+        }
+    }
+
+    std::vector<const Book*> CatalogSnapshot::listBooksAfter(const std::string& lastID, int limit) const {
+        std::vector<const Book*> page;
+        if (limit <= 0) return page;
+        books.forEachAfter(lastID, [&](const Book& book) {
+            page.push_back(&book);
+            return page.size() < static_cast<size_t>(limit);
+        });
+        return page;
+    }
+
+    std::vector<const User*> CatalogSnapshot::listUsersAfter(const std::string& lastID, int limit) const {
+        std::vector<const User*> page;
+        if (limit <= 0) return page;
+        users.forEachAfter(lastID, [&](const User& user) {
+            page.push_back(&user);
+            return page.size() < static_cast<size_t>(limit);
+        });
+        return page;
+    }
+
+    std::vector<const Book*> CatalogSnapshot::searchBooks(const std::string& text, int limit) const {
+        std::vector<const Book*> matches;
+        if (limit == 0) return matches;
+        books.forEachAfter("", [&](const Book& book) {
+            if (containsIgnoreCase(book.getBookName(), text) || containsIgnoreCase(book.getAuthor(), text))
+                matches.push_back(&book);
+            return limit < 0 || matches.size() < static_cast<size_t>(limit);
+        });
+        return matches;
+    }
+
+    CatalogMirror::CatalogMirror()
+        : mirrorID(nextMirrorID++), latest(std::make_shared<const CatalogSnapshot>()) {}
+
+    std::shared_ptr<const CatalogSnapshot> CatalogMirror::snapshot() const {
+        return std::atomic_load(&latest);
+    }
+
+    const CatalogSnapshot& CatalogMirror::current() const {
+        struct Cached {
+            uint64_t mirrorID = 0;
+            uint64_t version = 0;
+            std::shared_ptr<const CatalogSnapshot> snapshot;
+        };
+        thread_local Cached cached;
+        // One load of a counter that only changes on publish; the shared_ptr and its
+        // contended reference count are only touched when a new version appeared
+        uint64_t version = latestVersion.load(std::memory_order_acquire);
+        if (cached.mirrorID != mirrorID || cached.version != version || !cached.snapshot) {
+            cached.snapshot = snapshot();
+            cached.mirrorID = mirrorID;
+            cached.version = cached.snapshot->version();
+        }
+        return *cached.snapshot;
+    }
+
+    void CatalogMirror::reset(std::vector<Book> books, std::vector<User> users) {
+        std::vector<SnapshotTable<Book>::Change> bookRows;
+        bookRows.reserve(books.size());
+        for (auto& book : books)
+            bookRows.emplace_back(book.getBookID(), std::move(book));
+        std::vector<SnapshotTable<User>::Change> userRows;
+        userRows.reserve(users.size());
+        for (auto& user : users)
+            userRows.emplace_back(user.getUserID(), std::move(user));
+
+        std::lock_guard<std::mutex> lock(publishMutex);
+        auto next = std::make_shared<CatalogSnapshot>();
+        next->versionNumber = snapshot()->version() + 1;
+        next->books = SnapshotTable<Book>().apply(std::move(bookRows));
+        next->users = SnapshotTable<User>().apply(std::move(userRows));
+        install(std::move(next));
+    }
+
+    void CatalogMirror::publish(std::vector<Book> books, const std::vector<std::string>& removedBooks,
+                                std::vector<User> users, const std::vector<std::string>& removedUsers) {
+        std::vector<SnapshotTable<Book>::Change> bookChanges;
+        for (const auto& bookID : removedBooks)
+            bookChanges.emplace_back(bookID, std::nullopt);
+        for (auto& book : books)
+            bookChanges.emplace_back(book.getBookID(), std::move(book));
+        std::vector<SnapshotTable<User>::Change> userChanges;
+        for (const auto& userID : removedUsers)
+            userChanges.emplace_back(userID, std::nullopt);
+        for (auto& user : users)
+            userChanges.emplace_back(user.getUserID(), std::move(user));
+        if (bookChanges.empty() && userChanges.empty()) return;
+
+        std::lock_guard<std::mutex> lock(publishMutex);
+        auto base = snapshot();
+        auto next = std::make_shared<CatalogSnapshot>();
+        next->versionNumber = base->version() + 1;
+        next->books = bookChanges.empty() ? base->books : base->books.apply(std::move(bookChanges));
+        next->users = userChanges.empty() ? base->users : base->users.apply(std::move(userChanges));
+        install(std::move(next));
+    }
+
+    void CatalogMirror::install(std::shared_ptr<CatalogSnapshot> next) {
+        uint64_t version = next->version();
+        std::atomic_store(&latest, std::shared_ptr<const CatalogSnapshot>(std::move(next)));
+        // Published after the pointer, so a reader that sees the new version also
+        // loads the new snapshot
+        latestVersion.store(version, std::memory_order_release);
+    }
+}
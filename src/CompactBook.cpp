@@ -0,0 +1,85 @@
+#include "../include/lms/CompactBook.h"
+#include <cstring>
+
+namespace lms {
+    namespace {
+        // Fills id if text is canonical and not the all-zero ID, which stands for "none"
+        template <typename Tag>
+        bool parseNonNull(const std::string& text, BasicId<Tag>& id) {
+            return BasicId<Tag>::parse(text, id) && !id.isNull();
+        }
+    }
+
+    CompactBook::CompactBook(const Book& book, StringPool& pool)
+        : packed(static_cast<uint32_t>(book.getBookName().size()) | (book.available() ? kAvailableBit : 0)),
+          author(pool.intern(book.getAuthor())),
+          year(pool.intern(book.getPublicationYear())) {
+        const std::string& bookID = book.getBookID();
+        const std::string& user = book.getCurrentUser();
+        UserId userID;
+        if (!bookID.empty() && !parseNonNull(bookID, id)) customIdLength = static_cast<uint16_t>(bookID.size());
+        if (parseNonNull(user, userID)) packed |= kBorrowedBit;
+        else customUserLength = static_cast<uint16_t>(user.size());
+        if (size_t length = textLength()) {
+            text.reset(new char[length]);
+            char* out = text.get();
+            std::memcpy(out, book.getBookName().data(), nameLength());
+            out += nameLength();
+            std::memcpy(out, userID.data(), userIdLength());
+            out += userIdLength();
+            std::memcpy(out, bookID.data(), customIdLength);
+            std::memcpy(out + customIdLength, user.data(), customUserLength);
+        }
+        const auto& bookTags = book.getTags();
+        tags.reserve(bookTags.size());
+        for (const auto& tag : bookTags) tags.push_back(pool.intern(tag));
+    }
+
+    bool CompactBook::fits(const Book& book) {
+        return book.getBookName().size() <= kLengthMask &&
+               book.getBookID().size() <= kMaxCustomLength &&
+               book.getCurrentUser().size() <= kMaxCustomLength;
+    }
+
+    CompactBook::CompactBook(const CompactBook& other)
+        : id(other.id),
+          packed(other.packed),
+          customIdLength(other.customIdLength),
+          customUserLength(other.customUserLength),
+          author(other.author),
+          year(other.year),
+          tags(other.tags) {
+        if (size_t length = textLength()) {
+            text.reset(new char[length]);
+            std::memcpy(text.get(), other.text.get(), length);
+        }
+    }
+
+    CompactBook& CompactBook::operator=(const CompactBook& other) {
+        if (this != &other) *this = CompactBook(other);
+        return *this;
+    }
+
+    void CompactBook::moveStrings(const StringPool& from, StringPool& to) {
+        author = to.intern(from.view(author));
+        year = to.intern(from.view(year));
+        for (StringPool::Handle& tag : tags) tag = to.intern(from.view(tag));
+    }
+
+    Book CompactBook::toBook(const StringPool& pool) const {
+        Book book(std::string(getBookName()), std::string(pool.view(author)), std::string(pool.view(year)));
+        const char* rest = text.get() + nameLength();
+        if (packed & kBorrowedBit) book.setCurrentUser(UserId::fromBytes(rest).toHex());
+        rest += userIdLength();
+        if (customIdLength) book.setBookID(std::string(rest, customIdLength));
+        else if (!id.isNull()) book.setID(id);
+        if (customUserLength) book.setCurrentUser(std::string(rest + customIdLength, customUserLength));
+        std::vector<std::string> names;
+        names.reserve(tags.size());
+        for (StringPool::Handle tag : tags) names.emplace_back(pool.view(tag));
+        book.setTags(std::move(names));
+        book.setAvailable(available());
+        book.markClean();
+        return book;
+    }
+}
@@ -0,0 +1,63 @@
+#include "../include/lms/Cpu.h"
+#if LMS_X86 && defined(_MSC_VER)
+#include <intrin.h>
+#elif LMS_X86
+#include <cpuid.h>
+#endif
+
+namespace lms {
+    namespace cpu {
+#if LMS_X86
+        namespace {
+            void cpuid(int leaf, int subleaf, unsigned regs[4]) {
+#if defined(_MSC_VER)
+                int r[4];
+                __cpuidex(r, leaf, subleaf);
+                for (int i = 0; i < 4; ++i) regs[i] = static_cast<unsigned>(r[i]);
+#else
+                __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+            }
+        }
+
+        bool hasShaNi() {
+            unsigned regs[4];
+            cpuid(0, 0, regs);
+            if (regs[0] < 7) return false;
+            cpuid(1, 0, regs);
+            bool ssse3 = regs[2] & (1u << 9), sse41 = regs[2] & (1u << 19);
+            cpuid(7, 0, regs);
+            return ssse3 && sse41 && (regs[1] & (1u << 29));
+        }
+
+        bool hasAvx2() {
+            unsigned regs[4];
+            cpuid(0, 0, regs);
+            if (regs[0] < 7) return false;
+            cpuid(1, 0, regs);
+            // AVX and OS support for saving the YMM registers
+            if (!(regs[2] & (1u << 27)) || !(regs[2] & (1u << 28))) return false;
+#if defined(_MSC_VER)
+            unsigned long long xcr0 = _xgetbv(0);
+#else
+            unsigned eax, edx;
+            __asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+            unsigned long long xcr0 = (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+            if ((xcr0 & 6) != 6) return false;
+            cpuid(7, 0, regs);
+            return regs[1] & (1u << 5);
+        }
+
+        bool hasPopcnt() {
+            unsigned regs[4];
+            cpuid(1, 0, regs);
+            return regs[2] & (1u << 23);
+        }
+#else
+        bool hasShaNi() { return false; }
+        bool hasAvx2() { return false; }
+        bool hasPopcnt() { return false; }
+#endif
+    }
+}
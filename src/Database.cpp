@@ -1,9 +1,324 @@
 #include "../include/lms/Database.h"
+#include "../include/lms/Sha256.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <initializer_list>
 #include <iostream>
-#include <sstream>
+#include <string_view>
 
 namespace lms {
-    Database::Database(const std::string& dbPath) : dbPath(dbPath) {}
+    namespace {
+        // Resets a cached statement and drops its bindings when leaving scope,
+        // so the statement releases its read lock and is ready for the next call.
+        struct StatementReset {
+            sqlite3_stmt* stmt;
+            ~StatementReset() {
+                if (stmt) {
+                    sqlite3_reset(stmt);
+                    sqlite3_clear_bindings(stmt);
+                }
+            }
+        };
+
+        // IDs in canonical form (32 lowercase hex digits, as generateID produces) are
+        // stored as 16-byte BLOBs; any other ID is kept as TEXT. Conversion happens
+        // only here and in LMS_ID, so the rest of the code deals in hex strings.
+        // A text ID is bound in place, so id must outlive the statement's next step.
+        void bindId(sqlite3_stmt* stmt, int index, const std::string& id) {
+            BookId binary;
+            if (BookId::parse(id, binary))
+                sqlite3_bind_blob(stmt, index, binary.data(), BookId::kSize, SQLITE_TRANSIENT);
+            else
+                sqlite3_bind_text(stmt, index, id.data(), static_cast<int>(id.size()), SQLITE_STATIC);
+        }
+
+        // Binds text without copying it; text must outlive the statement's next step
+        void bindText(sqlite3_stmt* stmt, int index, const std::string& text) {
+            sqlite3_bind_text(stmt, index, text.data(), static_cast<int>(text.size()), SQLITE_STATIC);
+        }
+
+        // Binds the bytes in place; id must outlive the statement's next step
+        template <typename Tag>
+        void bindId(sqlite3_stmt* stmt, int index, const BasicId<Tag>& id) {
+            sqlite3_bind_blob(stmt, index, id.data(), BasicId<Tag>::kSize, SQLITE_STATIC);
+        }
+
+        // SQL function binary_id(x), used by the migration: the stored form of an ID.
+        // Built-in unhex() (SQLite 3.41+) would also convert upper-case hex, which is a
+        // custom ID that must stay TEXT, and is missing from the older system SQLite
+        // the build falls back to without the amalgamation.
+        void binaryIdFunction(sqlite3_context* context, int, sqlite3_value** argv) {
+            BookId binary;
+            if (sqlite3_value_type(argv[0]) == SQLITE_TEXT &&
+                BookId::parse(std::string_view(reinterpret_cast<const char*>(sqlite3_value_text(argv[0])),
+                                               static_cast<size_t>(sqlite3_value_bytes(argv[0]))), binary))
+                sqlite3_result_blob(context, binary.data(), BookId::kSize, SQLITE_TRANSIENT);
+            else
+                sqlite3_result_value(context, argv[0]);
+        }
+
+        // SQL function content_hash(field, ...): the first 16 bytes of SHA-256 over the
+        // concatenated fields, the same value a content-hash ID is made from
+        void contentHashFunction(sqlite3_context* context, int argc, sqlite3_value** argv) {
+            std::string data;
+            for (int i = 0; i < argc; ++i)
+                if (const unsigned char* text = sqlite3_value_text(argv[i]))
+                    data.append(reinterpret_cast<const char*>(text), static_cast<size_t>(sqlite3_value_bytes(argv[i])));
+            sha256::Digest hash = sha256::hash(data);
+            sqlite3_result_blob(context, hash.data(), 16, SQLITE_TRANSIENT);
+        }
+
+        // Reads a stored ID column back as its hex string (hex() is upper case)
+        #define LMS_ID(column) "(CASE WHEN typeof(" column ") = 'blob' THEN lower(hex(" column ")) ELSE " column " END)"
+
+        // Runs a cached single-row statement binding the given IDs to ?1, ?2, ...
+        // and returns the sqlite3_step result
+        int stepWith(sqlite3_stmt* stmt, std::initializer_list<const std::string*> ids) {
+            if (!stmt) return SQLITE_ERROR;
+            StatementReset reset{stmt};
+            int index = 1;
+            for (const std::string* id : ids)
+                bindId(stmt, index++, *id);
+            return sqlite3_step(stmt);
+        }
+
+        // Groups several statements into one atomic unit, rolled back unless commit()
+        // succeeds. Outside a transaction it takes the write lock up front with
+        // BEGIN IMMEDIATE; inside one (e.g. a batch insert) it nests as a savepoint.
+        class Transaction {
+        public:
+            explicit Transaction(sqlite3* db) : db(db), nested(!sqlite3_get_autocommit(db)) {
+                active = run(nested ? "SAVEPOINT lms;" : "BEGIN IMMEDIATE;");
+            }
+            ~Transaction() {
+                if (active)
+                    run(nested ? "ROLLBACK TO lms; RELEASE lms;" : "ROLLBACK;");
+            }
+            bool ok() const { return active; }
+            bool commit() {
+                if (!active) return false;
+                active = false;
+                if (run(nested ? "RELEASE lms;" : "COMMIT;")) return true;
+                run(nested ? "ROLLBACK TO lms; RELEASE lms;" : "ROLLBACK;");
+                return false;
+            }
+        private:
+            bool run(const char* sql) {
+                return sqlite3_exec(db, sql, nullptr, nullptr, nullptr) == SQLITE_OK;
+            }
+            sqlite3* db;
+            bool nested;
+            bool active = false;
+        };
+
+        // Tags are aggregated from book_tags with char(31), i.e. kTagSeparator
+        #define LMS_BOOK_COLUMNS LMS_ID("books.id") ", books.name, books.author, books.year, " LMS_ID("books.currentUser") ", " \
+            "(SELECT group_concat(tag, char(31)) FROM book_tags WHERE book_id = books.id)"
+        // Borrowed books come from the loans table, joined with commas (IDs are hex)
+        #define LMS_USER_COLUMNS LMS_ID("id") ", name, email, dob, address, " \
+            "(SELECT group_concat(" LMS_ID("book_id") ", ',') FROM loans WHERE user_id = users.id), is_active"
+
+        // Keep books_fts in sync with books, keyed by the given books column; created
+        // by migrateSearchIndex and again whenever books is rebuilt. Schema versions
+        // before migrateSearchRowids key it on the implicit rowid.
+        #define LMS_SEARCH_TRIGGERS(key) \
+            "CREATE TRIGGER IF NOT EXISTS books_fts_insert AFTER INSERT ON books BEGIN " \
+            "INSERT INTO books_fts (rowid, name, author) VALUES (new." key ", new.name, new.author); " \
+            "END;" \
+            "CREATE TRIGGER IF NOT EXISTS books_fts_delete AFTER DELETE ON books BEGIN " \
+            "INSERT INTO books_fts (books_fts, rowid, name, author) VALUES ('delete', old." key ", old.name, old.author); " \
+            "END;" \
+            "CREATE TRIGGER IF NOT EXISTS books_fts_update AFTER UPDATE OF name, author ON books BEGIN " \
+            "INSERT INTO books_fts (books_fts, rowid, name, author) VALUES ('delete', old." key ", old.name, old.author); " \
+            "INSERT INTO books_fts (rowid, name, author) VALUES (new." key ", new.name, new.author); " \
+            "END;"
+
+        // Loans created by borrowing are due after this many days
+        const int kLoanPeriodDays = 14;
+
+        // String pool budget of the book cache, per cached book and at least
+        const size_t kBookStringBytes = 256;
+        const size_t kMinBookStringBytes = 256 * 1024;
+
+        // sqlite3_column_text returns NULL for NULL columns
+        const char* columnText(sqlite3_stmt* stmt, int col) {
+            const unsigned char* text = sqlite3_column_text(stmt, col);
+            return text ? reinterpret_cast<const char*>(text) : "";
+        }
+
+        // Points at column memory instead of copying it; valid until the next step or reset
+        std::string_view columnView(sqlite3_stmt* stmt, int col) {
+            const unsigned char* text = sqlite3_column_text(stmt, col);
+            if (!text) return {};
+            return std::string_view(reinterpret_cast<const char*>(text), static_cast<size_t>(sqlite3_column_bytes(stmt, col)));
+        }
+
+        void readBookView(sqlite3_stmt* stmt, BookView& view) {
+            view.bookID = columnView(stmt, 0);
+            view.name = columnView(stmt, 1);
+            view.author = columnView(stmt, 2);
+            view.year = columnView(stmt, 3);
+            view.currentUser = columnView(stmt, 4);
+            view.tags = columnView(stmt, 5);
+            view.isAvailable = view.currentUser.empty();
+        }
+
+        void readUserView(sqlite3_stmt* stmt, UserView& view) {
+            view.userID = columnView(stmt, 0);
+            view.name = columnView(stmt, 1);
+            view.email = columnView(stmt, 2);
+            view.dob = columnView(stmt, 3);
+            view.address = columnView(stmt, 4);
+            view.borrowedBooks = columnView(stmt, 5);
+            view.isActive = sqlite3_column_int(stmt, 6) != 0;
+        }
+
+        // Fills book from a "SELECT " LMS_BOOK_COLUMNS row.
+        // tags is scratch space so repeated calls reuse its capacity.
+        void readBookRow(sqlite3_stmt* stmt, Book& book, std::vector<std::string>& tags) {
+            book.setBookID(columnText(stmt, 0));
+            book.setBookName(columnText(stmt, 1));
+            book.setAuthor(columnText(stmt, 2));
+            book.setPublicationYear(columnText(stmt, 3));
+            book.setCurrentUser(columnText(stmt, 4));
+            book.setAvailable(book.getCurrentUser().empty());
+            std::string tagsStr = columnText(stmt, 5);
+            tags.clear();
+            size_t start = 0, end = 0;
+            while ((end = tagsStr.find(kTagSeparator, start)) != std::string::npos) {
+                tags.push_back(tagsStr.substr(start, end - start));
+                start = end + 1;
+            }
+            if (!tagsStr.empty() && start < tagsStr.size())
+                tags.push_back(tagsStr.substr(start));
+            book.setTags(std::move(tags));
+            book.markClean();
+        }
+
+        // Fills user from a "SELECT " LMS_USER_COLUMNS row. Canonical borrowed IDs are
+        // parsed straight into BookIds; only custom ones become strings.
+        void readUserRow(sqlite3_stmt* stmt, User& user) {
+            user.setUserID(columnText(stmt, 0));
+            user.setName(columnText(stmt, 1));
+            user.setEmail(columnText(stmt, 2));
+            user.setDOB(columnText(stmt, 3));
+            user.setAddress(columnText(stmt, 4));
+            std::string_view loans = columnView(stmt, 5);
+            std::vector<BookId> borrowedBooks;
+            std::vector<std::string> customBooks;
+            if (!loans.empty()) borrowedBooks.reserve(std::count(loans.begin(), loans.end(), ',') + 1);
+            while (!loans.empty()) {
+                size_t end = std::min(loans.find(','), loans.size());
+                std::string_view bookID = loans.substr(0, end);
+                BookId id;
+                if (BookId::parse(bookID, id)) borrowedBooks.push_back(id);
+                else if (!bookID.empty()) customBooks.emplace_back(bookID);
+                loans.remove_prefix(std::min(end + 1, loans.size()));
+            }
+            user.setBorrowedBooks(std::move(borrowedBooks), std::move(customBooks));
+            user.setActive(sqlite3_column_int(stmt, 6) != 0);
+            user.markClean();
+        }
+
+        // One column of a partial UPDATE: its dirty-field bit, the parameter holding the
+        // new value (column is null for fields stored elsewhere), and whether the
+        // content_hash covers it
+        struct UpdateColumn {
+            uint8_t field;
+            const char* column;
+            const char* param;
+            bool hashed;
+        };
+
+        // Builds "UPDATE table SET <dirty columns> WHERE ..." for every combination of
+        // fields, indexed by the dirty mask ("" where no column is dirty). Parameter
+        // numbers are fixed per column, so one binding routine serves every variant.
+        // content_hash is recomputed whenever a field it covers changes, from the new
+        // values of the dirty fields and the stored values of the others, so it always
+        // matches the row whatever the clean fields of the caller's copy hold.
+        std::vector<std::string> buildUpdates(const char* table, const std::vector<UpdateColumn>& columns, const char* where) {
+            uint8_t allFields = 0;
+            for (const auto& column : columns) allFields |= column.field;
+            std::vector<std::string> updates(allFields + 1u);
+            for (unsigned fields = 1; fields <= allFields; ++fields) {
+                std::string set, hash;
+                bool rehash = false;
+                for (const auto& column : columns) {
+                    bool dirty = (fields & column.field) && column.column;
+                    if (dirty) {
+                        set += set.empty() ? "" : ", ";
+                        set += std::string(column.column) + " = " + column.param;
+                    }
+                    if (column.hashed) {
+                        hash += hash.empty() ? "" : ", ";
+                        hash += dirty ? column.param : column.column;
+                        rehash |= dirty;
+                    }
+                }
+                if (set.empty()) continue;
+                if (rehash) set += ", content_hash = content_hash(" + hash + ")";
+                updates[fields] = std::string("UPDATE ") + table + " SET " + set + " " + where;
+            }
+            return updates;
+        }
+
+        // ?1 name, ?2 author, ?3 year, ?4 currentUser, ?5 id
+        const std::string& bookUpdateSql(uint8_t fields) {
+            static const std::vector<std::string> updates = buildUpdates("books",
+                {{Book::NameField, "name", "?1", true}, {Book::AuthorField, "author", "?2", true},
+                 {Book::YearField, "year", "?3", true}, {Book::CurrentUserField, "currentUser", "?4", false},
+                 {Book::TagsField, nullptr, nullptr, false}},
+                "WHERE id = ?5;");
+            return updates[fields & Book::AllFields];
+        }
+
+        // ?1 name, ?2 email, ?3 dob, ?4 address, ?5 is_active, ?6 id
+        const std::string& userUpdateSql(uint8_t fields) {
+            static const std::vector<std::string> updates = buildUpdates("users",
+                {{User::NameField, "name", "?1", true}, {User::EmailField, "email", "?2", true},
+                 {User::DobField, "dob", "?3", true}, {User::AddressField, "address", "?4", true},
+                 {User::ActiveField, "is_active", "?5", false}},
+                "WHERE id = ?6;");
+            return updates[fields & User::AllFields];
+        }
+
+        // Books fetched by ID in one statement, kBookBatch placeholders at a time
+        constexpr size_t kBookBatch = 256;
+        const std::string& bookBatchSql() {
+            static const std::string sql = [] {
+                std::string text = "SELECT " LMS_BOOK_COLUMNS " FROM books WHERE id IN (?";
+                for (size_t i = 1; i < kBookBatch; ++i) text += ",?";
+                return text + ");";
+            }();
+            return sql;
+        }
+
+        // Reports an invalid query on std::cerr
+        bool parseTagQuery(const std::string& query, TagQuery& parsed) {
+            std::string error;
+            if (TagQuery::parse(query, parsed, &error)) return true;
+            std::cerr << "Invalid tag query \"" << query << "\": " << error << std::endl;
+            return false;
+        }
+    }
+
+    Database::ConnectionLease::ConnectionLease(const Database& owner, Connection& conn, std::unique_lock<std::mutex> writerLock)
+        : owner(&owner), conn(&conn), writerLock(std::move(writerLock)) {}
+
+    Database::ConnectionLease::ConnectionLease(ConnectionLease&& other) noexcept
+        : owner(other.owner), conn(other.conn), writerLock(std::move(other.writerLock)) {
+        other.conn = nullptr;
+    }
+
+    Database::ConnectionLease::~ConnectionLease() {
+        // Readers go back to the pool; the writer is released with its lock
+        if (conn && !writerLock.owns_lock())
+            owner->releaseReader(conn);
+    }
+
+    Database::Database(const std::string& dbPath, size_t readerConnections)
+        : dbPath(dbPath), readerCount(readerConnections) {}
 
     Database::~Database() {
         disconnect();
@@ -11,10 +326,16 @@ namespace lms {
 
     bool Database::connect() {
         if (connected) return true;
-        int rc = sqlite3_open(dbPath.c_str(), &db);
-        connected = (rc == SQLITE_OK);
-        if (!connected) {
-            std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
+        int rc = sqlite3_open(dbPath.c_str(), &writer.handle);
+        if (rc != SQLITE_OK) {
+            std::cerr << "Can't open database: " << sqlite3_errmsg(writer.handle) << std::endl;
+            closeConnection(writer);
+            return false;
+        }
+        sqlite3_busy_timeout(writer.handle, 5000);
+        // WAL lets the pooled readers run alongside the writer
+        if (readerCount > 0 && !exec(writer, "PRAGMA journal_mode = WAL;")) {
+            closeConnection(writer);
             return false;
         }
         // Create users table if it doesn't exist
@@ -27,11 +348,9 @@ namespace lms {
             "address TEXT, "
             "borrowed_books TEXT, "
             "is_active INTEGER);";
-        char* errMsg = nullptr;
-        rc = sqlite3_exec(db, userTableSQL, nullptr, nullptr, &errMsg);
-        if (rc != SQLITE_OK) {
-            std::cerr << "Error creating users table: " << (errMsg ? errMsg : "unknown") << std::endl;
-            sqlite3_free(errMsg);
+        if (!exec(writer, userTableSQL)) {
+            std::cerr << "Error creating users table" << std::endl;
+            closeConnection(writer);
             return false;
         }
         // Create books table if it doesn't exist
@@ -43,263 +362,1338 @@ namespace lms {
             "year TEXT, "
             "currentUser TEXT, "
             "tags TEXT);";
-        rc = sqlite3_exec(db, bookTableSQL, nullptr, nullptr, &errMsg);
-        if (rc != SQLITE_OK) {
-            std::cerr << "Error creating books table: " << (errMsg ? errMsg : "unknown") << std::endl;
-            sqlite3_free(errMsg);
+        if (!exec(writer, bookTableSQL)) {
+            std::cerr << "Error creating books table" << std::endl;
+            closeConnection(writer);
             return false;
         }
+        sqlite3_create_function(writer.handle, "binary_id", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr,
+                                binaryIdFunction, nullptr, nullptr);
+        sqlite3_create_function(writer.handle, "content_hash", -1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr,
+                                contentHashFunction, nullptr, nullptr);
+        if (!migrate(writer)) {
+            closeConnection(writer);
+            return false;
+        }
+        // Open the reader pool once the schema exists
+        for (size_t i = 0; i < readerCount; ++i) {
+            auto reader = std::make_unique<Connection>();
+            rc = sqlite3_open_v2(dbPath.c_str(), &reader->handle, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr);
+            if (rc != SQLITE_OK) {
+                std::cerr << "Can't open reader connection: " << sqlite3_errmsg(reader->handle) << std::endl;
+                closeConnection(*reader);
+                for (auto& opened : readers)
+                    closeConnection(*opened);
+                readers.clear();
+                idleReaders.clear();
+                closeConnection(writer);
+                return false;
+            }
+            sqlite3_busy_timeout(reader->handle, 5000);
+            idleReaders.push_back(reader.get());
+            readers.push_back(std::move(reader));
+        }
+        connected = true;
         return true;
     }
 
     void Database::disconnect() {
-        if (connected && db) {
-            sqlite3_close(db);
-            db = nullptr;
-            connected = false;
-        }
+        if (!connected) return;
+        stopAsyncWrites();
+        for (auto& reader : readers)
+            closeConnection(*reader);
+        readers.clear();
+        idleReaders.clear();
+        closeConnection(writer);
+        connected = false;
     }
 
     bool Database::isConnected() const {
         return connected;
     }
 
+    void Database::closeConnection(Connection& conn) {
+        for (auto& entry : conn.statements)
+            sqlite3_finalize(entry.second);
+        conn.statements.clear();
+        sqlite3_close(conn.handle);
+        conn.handle = nullptr;
+    }
+
+    Database::ConnectionLease Database::acquireWriter() const {
+        std::unique_lock<std::mutex> lock(writerMutex);
+        return ConnectionLease(*this, writer, std::move(lock));
+    }
+
+    Database::ConnectionLease Database::acquireReader() const {
+        // Without a pool, reads share the writer connection
+        if (readers.empty()) return acquireWriter();
+        std::unique_lock<std::mutex> lock(readerMutex);
+        readerAvailable.wait(lock, [this] { return !idleReaders.empty(); });
+        Connection* conn = idleReaders.back();
+        idleReaders.pop_back();
+        return ConnectionLease(*this, *conn, std::unique_lock<std::mutex>());
+    }
+
+    void Database::releaseReader(Connection* conn) const {
+        {
+            std::lock_guard<std::mutex> lock(readerMutex);
+            idleReaders.push_back(conn);
+        }
+        readerAvailable.notify_one();
+    }
+
+    sqlite3_stmt* Database::prepare(Connection& conn, const char* sql) const {
+        auto it = conn.statements.find(sql);
+        if (it != conn.statements.end()) {
+            ++statementHits;
+            return it->second;
+        }
+        ++statementMisses;
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v3(conn.handle, sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK) {
+            std::cerr << "Error preparing statement: " << sqlite3_errmsg(conn.handle) << std::endl;
+            sqlite3_finalize(stmt);
+            return nullptr;
+        }
+        conn.statements.emplace(sql, stmt);
+        return stmt;
+    }
+
+    bool Database::exec(Connection& conn, const char* sql) const {
+        char* errMsg = nullptr;
+        if (sqlite3_exec(conn.handle, sql, nullptr, nullptr, &errMsg) != SQLITE_OK) {
+            std::cerr << "Error executing '" << sql << "': " << (errMsg ? errMsg : "unknown") << std::endl;
+            sqlite3_free(errMsg);
+            return false;
+        }
+        return true;
+    }
+
+    bool Database::migrate(Connection& conn) {
+        // Schema changes applied in order on top of the original tables; the
+        // number of applied steps is kept in PRAGMA user_version
+        const std::vector<bool (Database::*)(Connection&)> steps = {
+            &Database::migrateBookTags,
+            &Database::migrateLoans,
+            &Database::migrateSearchIndex,
+            &Database::migrateLookupIndexes,
+            &Database::migrateBinaryIds,
+            &Database::migrateContentHash,
+            &Database::migrateSearchRowids,
+        };
+        for (size_t target = 1; target <= steps.size(); ++target) {
+            if (!exec(conn, "BEGIN IMMEDIATE;")) return false;
+            int version = 0;
+            sqlite3_stmt* stmt = nullptr;
+            if (sqlite3_prepare_v2(conn.handle, "PRAGMA user_version;", -1, &stmt, nullptr) == SQLITE_OK
+                && sqlite3_step(stmt) == SQLITE_ROW)
+                version = sqlite3_column_int(stmt, 0);
+            sqlite3_finalize(stmt);
+            if (version >= static_cast<int>(target)) {
+                exec(conn, "COMMIT;");
+                continue;
+            }
+            std::string setVersion = "PRAGMA user_version = " + std::to_string(target) + ";";
+            if (!(this->*steps[target - 1])(conn) || !exec(conn, setVersion.c_str()) || !exec(conn, "COMMIT;")) {
+                std::cerr << "Schema migration " << target << " failed" << std::endl;
+                exec(conn, "ROLLBACK;");
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool Database::migrateBookTags(Connection& conn) {
+        // Move the comma-joined books.tags column into an indexed book_tags table
+        const char* schemaSQL =
+            "CREATE TABLE IF NOT EXISTS book_tags ("
+            "book_id TEXT NOT NULL, "
+            "tag TEXT NOT NULL, "
+            "PRIMARY KEY (book_id, tag)) WITHOUT ROWID;"
+            "CREATE INDEX IF NOT EXISTS idx_book_tags_tag ON book_tags (tag, book_id);";
+        if (!exec(conn, schemaSQL)) return false;
+        sqlite3_stmt* select = nullptr;
+        sqlite3_stmt* insert = nullptr;
+        bool ok = sqlite3_prepare_v2(conn.handle, "SELECT id, tags FROM books WHERE tags <> '';", -1, &select, nullptr) == SQLITE_OK
+            && sqlite3_prepare_v2(conn.handle, "INSERT OR IGNORE INTO book_tags (book_id, tag) VALUES (?, ?);", -1, &insert, nullptr) == SQLITE_OK;
+        while (ok && sqlite3_step(select) == SQLITE_ROW) {
+            std::string tagsStr = columnText(select, 1);
+            size_t start = 0;
+            while (ok && start <= tagsStr.size()) {
+                size_t end = tagsStr.find(',', start);
+                if (end == std::string::npos) end = tagsStr.size();
+                if (end > start) {
+                    sqlite3_bind_text(insert, 1, columnText(select, 0), -1, SQLITE_TRANSIENT);
+                    sqlite3_bind_text(insert, 2, tagsStr.c_str() + start, static_cast<int>(end - start), SQLITE_TRANSIENT);
+                    ok = sqlite3_step(insert) == SQLITE_DONE;
+                    sqlite3_reset(insert);
+                }
+                start = end + 1;
+            }
+        }
+        sqlite3_finalize(select);
+        sqlite3_finalize(insert);
+        return ok && exec(conn, "ALTER TABLE books DROP COLUMN tags;");
+    }
+
+    bool Database::migrateLoans(Connection& conn) {
+        // Replace the comma-joined users.borrowed_books column with one loans row per
+        // borrowed book. The original borrow time is unknown, so existing loans start now.
+        const char* schemaSQL =
+            "CREATE TABLE IF NOT EXISTS loans ("
+            "user_id TEXT NOT NULL, "
+            "book_id TEXT NOT NULL, "
+            "borrowed_at INTEGER NOT NULL, "
+            "due_at INTEGER NOT NULL, "
+            "PRIMARY KEY (user_id, book_id)) WITHOUT ROWID;"
+            "CREATE UNIQUE INDEX IF NOT EXISTS idx_loans_book ON loans (book_id);";
+        if (!exec(conn, schemaSQL)) return false;
+        sqlite3_stmt* select = nullptr;
+        sqlite3_stmt* insert = nullptr;
+        const char* insertSQL =
+            "INSERT OR IGNORE INTO loans (user_id, book_id, borrowed_at, due_at) "
+            "VALUES (?1, ?2, CAST(strftime('%s', 'now') AS INTEGER), CAST(strftime('%s', 'now') AS INTEGER) + ?3);";
+        bool ok = sqlite3_prepare_v2(conn.handle, "SELECT id, borrowed_books FROM users WHERE borrowed_books <> '';", -1, &select, nullptr) == SQLITE_OK
+            && sqlite3_prepare_v2(conn.handle, insertSQL, -1, &insert, nullptr) == SQLITE_OK;
+        while (ok && sqlite3_step(select) == SQLITE_ROW) {
+            std::string borrowed = columnText(select, 1);
+            size_t start = 0;
+            while (ok && start <= borrowed.size()) {
+                size_t end = borrowed.find(',', start);
+                if (end == std::string::npos) end = borrowed.size();
+                if (end > start) {
+                    sqlite3_bind_text(insert, 1, columnText(select, 0), -1, SQLITE_TRANSIENT);
+                    sqlite3_bind_text(insert, 2, borrowed.c_str() + start, static_cast<int>(end - start), SQLITE_TRANSIENT);
+                    sqlite3_bind_int(insert, 3, kLoanPeriodDays * 24 * 60 * 60);
+                    ok = sqlite3_step(insert) == SQLITE_DONE;
+                    sqlite3_reset(insert);
+                }
+                start = end + 1;
+            }
+        }
+        sqlite3_finalize(select);
+        sqlite3_finalize(insert);
+        return ok && exec(conn, "ALTER TABLE users DROP COLUMN borrowed_books;");
+    }
+
+    bool Database::migrateSearchIndex(Connection& conn) {
+        // External-content FTS5 index over books(name, author), kept in sync by
+        // triggers and ranked with BM25 weighting title matches above author matches
+        const char* schemaSQL =
+            "CREATE VIRTUAL TABLE IF NOT EXISTS books_fts USING fts5("
+            "name, author, content = 'books', content_rowid = 'rowid', tokenize = 'unicode61 remove_diacritics 2');"
+            LMS_SEARCH_TRIGGERS("rowid")
+            "INSERT INTO books_fts (books_fts, rank) VALUES ('rank', 'bm25(10.0, 5.0)');"
+            "INSERT INTO books_fts (books_fts) VALUES ('rebuild');";
+        return exec(conn, schemaSQL);
+    }
+
+    bool Database::migrateLookupIndexes(Connection& conn) {
+        // Publication years are free text; the expression index orders them numerically
+        const char* schemaSQL =
+            "CREATE INDEX IF NOT EXISTS idx_books_author ON books (author);"
+            "CREATE INDEX IF NOT EXISTS idx_books_year ON books (CAST(year AS INTEGER));"
+            "CREATE INDEX IF NOT EXISTS idx_books_current_user ON books (currentUser);";
+        return exec(conn, schemaSQL);
+    }
+
+    bool Database::migrateBinaryIds(Connection& conn) {
+        // Rebuild every table holding IDs with BLOB columns, converting canonical hex
+        // IDs to 16 bytes. books keeps its rowids, which books_fts refers to; the
+        // other tables are keyed by ID alone and become WITHOUT ROWID.
+        const char* schemaSQL =
+            "CREATE TABLE books_new (id BLOB PRIMARY KEY, name TEXT, author TEXT, year TEXT, currentUser BLOB);"
+            "INSERT INTO books_new (rowid, id, name, author, year, currentUser) "
+            "SELECT rowid, binary_id(id), name, author, year, binary_id(currentUser) FROM books;"
+            "DROP TABLE books;"
+            "ALTER TABLE books_new RENAME TO books;"
+            "CREATE TABLE users_new (id BLOB PRIMARY KEY, name TEXT, email TEXT, dob TEXT, address TEXT, is_active INTEGER) WITHOUT ROWID;"
+            "INSERT INTO users_new SELECT binary_id(id), name, email, dob, address, is_active FROM users;"
+            "DROP TABLE users;"
+            "ALTER TABLE users_new RENAME TO users;"
+            "CREATE TABLE loans_new ("
+            "user_id BLOB NOT NULL, "
+            "book_id BLOB NOT NULL, "
+            "borrowed_at INTEGER NOT NULL, "
+            "due_at INTEGER NOT NULL, "
+            "PRIMARY KEY (user_id, book_id)) WITHOUT ROWID;"
+            "INSERT INTO loans_new SELECT binary_id(user_id), binary_id(book_id), borrowed_at, due_at FROM loans;"
+            "DROP TABLE loans;"
+            "ALTER TABLE loans_new RENAME TO loans;"
+            "CREATE UNIQUE INDEX idx_loans_book ON loans (book_id);"
+            "CREATE TABLE book_tags_new (book_id BLOB NOT NULL, tag TEXT NOT NULL, PRIMARY KEY (book_id, tag)) WITHOUT ROWID;"
+            "INSERT INTO book_tags_new SELECT binary_id(book_id), tag FROM book_tags;"
+            "DROP TABLE book_tags;"
+            "ALTER TABLE book_tags_new RENAME TO book_tags;"
+            "CREATE INDEX idx_book_tags_tag ON book_tags (tag, book_id);"
+            LMS_SEARCH_TRIGGERS("rowid");
+        // Dropping books also dropped its indexes
+        return exec(conn, schemaSQL) && migrateLookupIndexes(conn);
+    }
+
+    bool Database::migrateContentHash(Connection& conn) {
+        // Duplicate detection independent of the ID, so time-ordered IDs still refuse a
+        // second copy of a row. Existing duplicates (possible under custom IDs) keep a
+        // NULL hash rather than failing the migration.
+        const char* schemaSQL =
+            "ALTER TABLE books ADD COLUMN content_hash BLOB;"
+            "ALTER TABLE users ADD COLUMN content_hash BLOB;"
+            "CREATE UNIQUE INDEX idx_books_content_hash ON books (content_hash);"
+            "CREATE UNIQUE INDEX idx_users_content_hash ON users (content_hash);"
+            "UPDATE OR IGNORE books SET content_hash = content_hash(name, author, year);"
+            "UPDATE OR IGNORE users SET content_hash = content_hash(name, email, dob, address);";
+        return exec(conn, schemaSQL);
+    }
+
+    bool Database::migrateSearchRowids(Connection& conn) {
+        // books_fts was keyed on books' implicit rowid, which VACUUM may renumber and
+        // so desync the index from its rows. Rebuild books with an INTEGER PRIMARY KEY
+        // (an alias of the rowid that never changes), keeping the current values, and
+        // key books_fts on it. id stays unique through its own index.
+        const char* schemaSQL =
+            "CREATE TABLE books_new (search_rowid INTEGER PRIMARY KEY, id BLOB UNIQUE, name TEXT, author TEXT, "
+            "year TEXT, currentUser BLOB, content_hash BLOB);"
+            "INSERT INTO books_new (search_rowid, id, name, author, year, currentUser, content_hash) "
+            "SELECT rowid, id, name, author, year, currentUser, content_hash FROM books;"
+            "DROP TABLE books_fts;"
+            "DROP TABLE books;"
+            "ALTER TABLE books_new RENAME TO books;"
+            "CREATE UNIQUE INDEX idx_books_content_hash ON books (content_hash);"
+            "CREATE VIRTUAL TABLE books_fts USING fts5("
+            "name, author, content = 'books', content_rowid = 'search_rowid', tokenize = 'unicode61 remove_diacritics 2');"
+            LMS_SEARCH_TRIGGERS("search_rowid")
+            "INSERT INTO books_fts (books_fts, rank) VALUES ('rank', 'bm25(10.0, 5.0)');"
+            "INSERT INTO books_fts (books_fts) VALUES ('rebuild');";
+        // Dropping books also dropped its indexes
+        return exec(conn, schemaSQL) && migrateLookupIndexes(conn);
+    }
+
+    std::vector<bool> Database::insertInChunks(size_t count, size_t chunkSize, const std::function<bool(Connection&, size_t)>& insertRow) {
+        std::vector<bool> status(count, false);
+        if (!connected) return status;
+        if (chunkSize == 0) chunkSize = count;
+        auto lease = acquireWriter();
+        Connection& conn = *lease;
+        for (size_t begin = 0; begin < count; begin += chunkSize) {
+            size_t end = std::min(count, begin + chunkSize);
+            if (!exec(conn, "BEGIN;")) return status;
+            // A failed row (e.g. duplicate id) only aborts its own statement, not the chunk
+            for (size_t i = begin; i < end; ++i)
+                status[i] = insertRow(conn, i);
+            bool committed = exec(conn, "COMMIT;");
+            if (!committed) exec(conn, "ROLLBACK;");
+            publishChanges(conn);
+            if (!committed) {
+                std::fill(status.begin() + begin, status.begin() + end, false);
+                return status;
+            }
+        }
+        return status;
+    }
+
+    bool Database::startAsyncWrites(const AsyncWriteOptions& options) {
+        if (!connected) return false;
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (asyncRunning) return true;
+        asyncOptions = options;
+        if (asyncOptions.maxBatchSize == 0) asyncOptions.maxBatchSize = 1;
+        asyncStopping = false;
+        asyncRunning = true;
+        asyncWriter = std::thread(&Database::asyncWriterLoop, this);
+        return true;
+    }
+
+    void Database::stopAsyncWrites() {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            if (!asyncRunning) return;
+            asyncStopping = true;
+        }
+        queueReady.notify_all();
+        asyncWriter.join();
+        std::lock_guard<std::mutex> lock(queueMutex);
+        asyncRunning = false;
+    }
+
+    AsyncWriteStats Database::asyncWriteStats() const {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        return asyncStats;
+    }
+
+    template <typename T>
+    std::future<T> Database::enqueueWrite(std::function<T(Connection&)> op, T failure) {
+        auto promise = std::make_shared<std::promise<T>>();
+        std::future<T> future = promise->get_future();
+        if (!connected) {
+            promise->set_value(failure);
+            return future;
+        }
+        auto result = std::make_shared<T>(failure);
+        PendingWrite write;
+        write.apply = [op, result, failure](Connection& conn) { return (*result = op(conn)) != failure; };
+        write.complete = [promise, result, failure](bool committed) { promise->set_value(committed ? *result : failure); };
+        write.enqueued = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            if (asyncRunning && !asyncStopping) {
+                writeQueue.push_back(std::move(write));
+                // Wake the writer for the first write of a batch or once a batch is full
+                if (writeQueue.size() == 1 || writeQueue.size() >= asyncOptions.maxBatchSize)
+                    queueReady.notify_one();
+                return future;
+            }
+        }
+        // Not in async mode: behave like the synchronous call
+        {
+            auto lease = acquireWriter();
+            write.apply(*lease);
+            publishChanges(*lease);
+        }
+        write.complete(true);
+        return future;
+    }
+
+    void Database::asyncWriterLoop() {
+        std::vector<PendingWrite> batch;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queueReady.wait(lock, [this] { return !writeQueue.empty() || asyncStopping; });
+                if (writeQueue.empty()) return; // Stopping and fully drained
+                // Group commit window: give other writers until the oldest write's
+                // deadline to join this batch
+                auto deadline = writeQueue.front().enqueued + asyncOptions.maxDelay;
+                queueReady.wait_until(lock, deadline, [this] {
+                    return writeQueue.size() >= asyncOptions.maxBatchSize || asyncStopping;
+                });
+                size_t count = std::min(writeQueue.size(), asyncOptions.maxBatchSize);
+                for (size_t i = 0; i < count; ++i) {
+                    batch.push_back(std::move(writeQueue.front()));
+                    writeQueue.pop_front();
+                }
+            }
+            commitBatch(batch);
+            batch.clear();
+        }
+    }
+
+    void Database::commitBatch(std::vector<PendingWrite>& batch) {
+        bool committed = false;
+        {
+            auto lease = acquireWriter();
+            Connection& conn = *lease;
+            if (exec(conn, "BEGIN IMMEDIATE;")) {
+                // Each write runs in its own savepoint, so whatever a failing write
+                // did is rolled back without affecting the others in the batch
+                for (auto& write : batch) {
+                    Transaction savepoint(conn.handle);
+                    if (write.apply(conn)) savepoint.commit();
+                }
+                committed = exec(conn, "COMMIT;");
+                if (!committed) exec(conn, "ROLLBACK;");
+            }
+            publishChanges(conn);
+        }
+        auto now = std::chrono::steady_clock::now();
+        double totalLatencyMs = 0.0, maxLatencyMs = 0.0;
+        for (auto& write : batch) {
+            double latencyMs = std::chrono::duration<double, std::milli>(now - write.enqueued).count();
+            totalLatencyMs += latencyMs;
+            maxLatencyMs = std::max(maxLatencyMs, latencyMs);
+            write.complete(committed);
+        }
+        std::lock_guard<std::mutex> lock(statsMutex);
+        uint64_t previousWrites = asyncStats.writes;
+        asyncStats.batches++;
+        asyncStats.writes += batch.size();
+        if (!committed) asyncStats.failedBatches++;
+        asyncStats.largestBatch = std::max(asyncStats.largestBatch, batch.size());
+        asyncStats.averageBatchSize = static_cast<double>(asyncStats.writes) / asyncStats.batches;
+        asyncStats.averageLatencyMs = (asyncStats.averageLatencyMs * previousWrites + totalLatencyMs) / asyncStats.writes;
+        asyncStats.maxLatencyMs = std::max(asyncStats.maxLatencyMs, maxLatencyMs);
+    }
+
+    std::future<bool> Database::addBookAsync(const Book& book) {
+        return enqueueWrite<bool>([this, book](Connection& conn) { return addBook(conn, book); }, false);
+    }
+
+    std::future<bool> Database::updateBookAsync(const Book& book) {
+        return enqueueWrite<bool>([this, book](Connection& conn) { return updateBook(conn, book); }, false);
+    }
+
+    std::future<bool> Database::removeBookAsync(const std::string& bookID) {
+        return enqueueWrite<bool>([this, bookID](Connection& conn) { return removeBook(conn, bookID); }, false);
+    }
+
+    std::future<bool> Database::addUserAsync(const User& user) {
+        return enqueueWrite<bool>([this, user](Connection& conn) { return addUser(conn, user); }, false);
+    }
+
+    std::future<bool> Database::updateUserAsync(const User& user) {
+        return enqueueWrite<bool>([this, user](Connection& conn) { return updateUser(conn, user); }, false);
+    }
+
+    std::future<bool> Database::removeUserAsync(const std::string& userID) {
+        return enqueueWrite<bool>([this, userID](Connection& conn) { return removeUser(conn, userID); }, false);
+    }
+
+    std::future<LoanStatus> Database::borrowBookAsync(const std::string& userID, const std::string& bookID) {
+        return enqueueWrite<LoanStatus>([this, userID, bookID](Connection& conn) { return borrowBook(conn, userID, bookID); },
+                                        LoanStatus::Error);
+    }
+
+    std::future<LoanStatus> Database::returnBookAsync(const std::string& userID, const std::string& bookID) {
+        return enqueueWrite<LoanStatus>([this, userID, bookID](Connection& conn) { return returnBook(conn, userID, bookID); },
+                                        LoanStatus::Error);
+    }
+
+    void Database::enableObjectCache(size_t bookCapacity, size_t userCapacity) {
+        bookCache = bookCapacity ? std::make_unique<TinyLfuCache<BookId, CompactBook>>(bookCapacity) : nullptr;
+        userCache = userCapacity ? std::make_unique<TinyLfuCache<UserId, User>>(userCapacity) : nullptr;
+        bookStrings = std::make_unique<StringPool>();
+        // Room for a few distinct strings per cached book before the pool is rebuilt
+        bookStringsBaseLimit = std::max<size_t>(bookCapacity * kBookStringBytes, kMinBookStringBytes);
+        bookStringsLimit = bookStringsBaseLimit;
+    }
+
+    CacheStats Database::bookCacheStats() const {
+        if (!bookCache) return CacheStats();
+        CacheStats stats = bookCache->stats();
+        std::shared_lock<std::shared_mutex> lock(bookStringsMutex);
+        stats.sharedBytes = bookStrings->memoryUsage();
+        return stats;
+    }
+
+    void Database::rebuildBookStrings() const {
+        std::unique_lock<std::shared_mutex> lock(bookStringsMutex);
+        if (bookStrings->memoryUsage() <= bookStringsLimit) return;    // Another thread got here first
+        // Only the strings of books still cached survive; the limit then leaves as much
+        // room again as they take, so rebuilds stay rare however large the live set is
+        auto fresh = std::make_unique<StringPool>();
+        bookCache->forEachValue([&](CompactBook& book) { book.moveStrings(*bookStrings, *fresh); });
+        bookStrings = std::move(fresh);
+        bookStringsLimit = std::max(bookStringsBaseLimit, 2 * bookStrings->memoryUsage());
+    }
+
+    CacheStats Database::userCacheStats() const {
+        return userCache ? userCache->stats() : CacheStats();
+    }
+
+    void Database::touchBook(const std::string& bookID) {
+        changedBooks.push_back(bookID);
+    }
+
+    void Database::touchUser(const std::string& userID) {
+        changedUsers.push_back(userID);
+    }
+
+    void Database::publishChanges(Connection& conn) {
+        if (changedBooks.empty() && changedUsers.empty()) return;
+        // Bump the epoch before erasing: a load that read the old row either sees the
+        // new epoch and skips caching, or caches first and is erased here
+        ++cacheEpoch;
+        std::sort(changedBooks.begin(), changedBooks.end());
+        changedBooks.erase(std::unique(changedBooks.begin(), changedBooks.end()), changedBooks.end());
+        std::sort(changedUsers.begin(), changedUsers.end());
+        changedUsers.erase(std::unique(changedUsers.begin(), changedUsers.end()), changedUsers.end());
+        // Only canonical IDs are ever cached
+        if (bookCache) {
+            BookId id;
+            for (const auto& bookID : changedBooks)
+                if (BookId::parse(bookID, id)) bookCache->erase(id);
+        }
+        if (userCache) {
+            UserId id;
+            for (const auto& userID : changedUsers)
+                if (UserId::parse(userID, id)) userCache->erase(id);
+        }
+        if (catalog) refreshCatalog(conn);
+        if (tagPostings) refreshTagIndex(conn);
+        changedBooks.clear();
+        changedUsers.clear();
+    }
+
+    bool Database::enableCatalogMirror() {
+        if (!connected) return false;
+        // Loading on the writer keeps writes out until the mirror is in place
+        auto lease = acquireWriter();
+        Connection& conn = *lease;
+        sqlite3_stmt* bookStmt = prepare(conn, "SELECT " LMS_BOOK_COLUMNS " FROM books;");
+        sqlite3_stmt* userStmt = prepare(conn, "SELECT " LMS_USER_COLUMNS " FROM users;");
+        if (!bookStmt || !userStmt) return false;
+        std::vector<Book> books;
+        std::vector<User> users;
+        std::vector<std::string> scratch;
+        {
+            StatementReset reset{bookStmt};
+            while (sqlite3_step(bookStmt) == SQLITE_ROW) {
+                books.emplace_back("", "", "");
+                readBookRow(bookStmt, books.back(), scratch);
+            }
+        }
+        {
+            StatementReset reset{userStmt};
+            while (sqlite3_step(userStmt) == SQLITE_ROW) {
+                users.emplace_back("", "");
+                readUserRow(userStmt, users.back());
+            }
+        }
+        auto mirror = std::make_unique<CatalogMirror>();
+        mirror->reset(std::move(books), std::move(users));
+        catalog = std::move(mirror);
+        return true;
+    }
+
+    const CatalogMirror* Database::catalogMirror() const {
+        return catalog.get();
+    }
+
+    void Database::refreshCatalog(Connection& conn) {
+        // Runs on the writer right after the commit, so it reads exactly the committed
+        // rows; a touched row that no longer exists was removed
+        std::vector<Book> books;
+        std::vector<User> users;
+        std::vector<std::string> removedBooks, removedUsers, scratch;
+        sqlite3_stmt* bookStmt = prepare(conn, "SELECT " LMS_BOOK_COLUMNS " FROM books WHERE id = ?;");
+        sqlite3_stmt* userStmt = prepare(conn, "SELECT " LMS_USER_COLUMNS " FROM users WHERE id = ?;");
+        if (!bookStmt || !userStmt) {
+            std::cerr << "Catalog mirror could not be refreshed" << std::endl;
+            return;
+        }
+        for (const auto& bookID : changedBooks) {
+            StatementReset reset{bookStmt};
+            bindId(bookStmt, 1, bookID);
+            int rc = sqlite3_step(bookStmt);
+            if (rc == SQLITE_ROW) {
+                books.emplace_back("", "", "");
+                readBookRow(bookStmt, books.back(), scratch);
+            } else if (rc == SQLITE_DONE) {
+                removedBooks.push_back(bookID);
+            }
+        }
+        for (const auto& userID : changedUsers) {
+            StatementReset reset{userStmt};
+            bindId(userStmt, 1, userID);
+            int rc = sqlite3_step(userStmt);
+            if (rc == SQLITE_ROW) {
+                users.emplace_back("", "");
+                readUserRow(userStmt, users.back());
+            } else if (rc == SQLITE_DONE) {
+                removedUsers.push_back(userID);
+            }
+        }
+        catalog->publish(std::move(books), removedBooks, std::move(users), removedUsers);
+    }
+
+    bool Database::enableTagIndex() {
+        if (!connected) return false;
+        // Loading on the writer keeps writes out until the index is in place; rows come
+        // in ID order, so ordinals start out in ID order too
+        auto lease = acquireWriter();
+        Connection& conn = *lease;
+        sqlite3_stmt* stmt = prepare(conn, "SELECT " LMS_ID("id") ", "
+            "(SELECT group_concat(tag, char(31)) FROM book_tags WHERE book_id = books.id) FROM books ORDER BY id;");
+        if (!stmt) return false;
+        auto index = std::make_unique<TagIndex>();
+        StatementReset reset{stmt};
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+            index->setBook(columnView(stmt, 0), columnView(stmt, 1));
+        if (rc != SQLITE_DONE) {
+            std::cerr << "Error loading tag index: " << sqlite3_errmsg(conn.handle) << std::endl;
+            return false;
+        }
+        tagPostings = std::move(index);
+        return true;
+    }
+
+    const TagIndex* Database::tagIndex() const {
+        return tagPostings.get();
+    }
+
+    void Database::refreshTagIndex(Connection& conn) {
+        sqlite3_stmt* stmt = prepare(conn, "SELECT EXISTS (SELECT 1 FROM books WHERE id = ?1), "
+            "(SELECT group_concat(tag, char(31)) FROM book_tags WHERE book_id = ?1);");
+        if (!stmt) {
+            std::cerr << "Tag index could not be refreshed" << std::endl;
+            return;
+        }
+        for (const auto& bookID : changedBooks) {
+            StatementReset reset{stmt};
+            bindId(stmt, 1, bookID);
+            if (sqlite3_step(stmt) != SQLITE_ROW) continue;
+            if (sqlite3_column_int(stmt, 0)) tagPostings->setBook(bookID, columnView(stmt, 1));
+            else tagPostings->removeBook(bookID);
+        }
+    }
+
+    uint64_t Database::statementCacheHits() const {
+        return statementHits;
+    }
+
+    uint64_t Database::statementCacheMisses() const {
+        return statementMisses;
+    }
+
 
 
 
     // Book operations
     bool Database::addBook(const Book& book) {
         if (!connected) return false;
-        const char* sql = "INSERT INTO books (id, name, author, year, currentUser, tags) VALUES (?, ?, ?, ?, ?, ?);";
-        sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) return false;
-        sqlite3_bind_text(stmt, 1, book.getBookID().c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(stmt, 2, book.getBookName().c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(stmt, 3, book.getAuthor().c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(stmt, 4, book.getPublicationYear().c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(stmt, 5, book.getCurrentUser().c_str(), -1, SQLITE_TRANSIENT);
-        // Assume book.getTags() returns a vector<string> of tags, store as comma-separated string
-        std::string tagsStr;
-        const auto& tags = book.getTags();
-        for (size_t i = 0; i < tags.size(); ++i) {
-            tagsStr += tags[i];
-            if (i + 1 < tags.size()) tagsStr += ",";
-        }
-        sqlite3_bind_text(stmt, 6, tagsStr.c_str(), -1, SQLITE_TRANSIENT);
-        bool success = (sqlite3_step(stmt) == SQLITE_DONE);
-        sqlite3_finalize(stmt);
-        return success;
+        auto lease = acquireWriter();
+        bool result = addBook(*lease, book);
+        publishChanges(*lease);
+        return result;
+    }
+
+    std::vector<bool> Database::addBooks(const std::vector<Book>& books, size_t chunkSize) {
+        return insertInChunks(books.size(), chunkSize, [&](Connection& conn, size_t i) { return addBook(conn, books[i]); });
+    }
+
+    bool Database::addBook(Connection& conn, const Book& book) {
+        touchBook(book.getBookID());
+        const char* sql = "INSERT INTO books (id, name, author, year, currentUser, content_hash) "
+                          "VALUES (?1, ?2, ?3, ?4, ?5, content_hash(?2, ?3, ?4));";
+        sqlite3_stmt* stmt = prepare(conn, sql);
+        if (!stmt) return false;
+        Transaction txn(conn.handle);
+        if (!txn.ok()) return false;
+        {
+            StatementReset reset{stmt};
+            bindId(stmt, 1, book.getBookID());
+            bindText(stmt, 2, book.getBookName());
+            bindText(stmt, 3, book.getAuthor());
+            bindText(stmt, 4, book.getPublicationYear());
+            bindId(stmt, 5, book.getCurrentUser());
+            if (sqlite3_step(stmt) != SQLITE_DONE) return false;
+        }
+        return writeTags(conn, book.getBookID(), book.getTags()) && txn.commit();
+    }
+
+    bool Database::writeTags(Connection& conn, const std::string& bookID, const std::vector<std::string>& tags) {
+        sqlite3_stmt* clear = prepare(conn, "DELETE FROM book_tags WHERE book_id = ?;");
+        sqlite3_stmt* insert = prepare(conn, "INSERT OR IGNORE INTO book_tags (book_id, tag) VALUES (?, ?);");
+        if (!clear || !insert) return false;
+        {
+            StatementReset reset{clear};
+            bindId(clear, 1, bookID);
+            if (sqlite3_step(clear) != SQLITE_DONE) return false;
+        }
+        for (const auto& tag : tags) {
+            StatementReset reset{insert};
+            bindId(insert, 1, bookID);
+            bindText(insert, 2, tag);
+            if (sqlite3_step(insert) != SQLITE_DONE) return false;
+        }
+        return true;
     }
 
     bool Database::removeBook(const std::string& bookID) {
         if (!connected) return false;
-        const char* sql = "DELETE FROM books WHERE id = ?;";
-        sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) return false;
-        sqlite3_bind_text(stmt, 1, bookID.c_str(), -1, SQLITE_TRANSIENT);
-        bool success = (sqlite3_step(stmt) == SQLITE_DONE);
-        sqlite3_finalize(stmt);
-        return success;
+        auto lease = acquireWriter();
+        bool result = removeBook(*lease, bookID);
+        publishChanges(*lease);
+        return result;
+    }
+
+    bool Database::removeBook(Connection& conn, const std::string& bookID) {
+        touchBook(bookID);
+        // The borrower's loan list changes along with the book
+        std::string borrower;
+        if (sqlite3_stmt* holder = prepare(conn, "SELECT " LMS_ID("user_id") " FROM loans WHERE book_id = ?;")) {
+            StatementReset reset{holder};
+            bindId(holder, 1, bookID);
+            if (sqlite3_step(holder) == SQLITE_ROW) borrower = columnText(holder, 0);
+        }
+        if (!borrower.empty()) touchUser(borrower);
+        sqlite3_stmt* stmt = prepare(conn, "DELETE FROM books WHERE id = ?;");
+        if (!stmt) return false;
+        Transaction txn(conn.handle);
+        if (!txn.ok()) return false;
+        {
+            StatementReset reset{stmt};
+            bindId(stmt, 1, bookID);
+            if (sqlite3_step(stmt) != SQLITE_DONE) return false;
+        }
+        sqlite3_stmt* loan = prepare(conn, "DELETE FROM loans WHERE book_id = ?;");
+        if (!loan) return false;
+        {
+            StatementReset reset{loan};
+            bindId(loan, 1, bookID);
+            if (sqlite3_step(loan) != SQLITE_DONE) return false;
+        }
+        return writeTags(conn, bookID, {}) && txn.commit();
     }
 
     bool Database::updateBook(const Book& book) {
         if (!connected) return false;
-        const char* sql = "UPDATE books SET name = ?, author = ?, year = ?, currentUser = ?, tags = ? WHERE id = ?;";
-        sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) return false;
-        sqlite3_bind_text(stmt, 1, book.getBookName().c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(stmt, 2, book.getAuthor().c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(stmt, 3, book.getPublicationYear().c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(stmt, 4, book.getCurrentUser().c_str(), -1, SQLITE_TRANSIENT);
-        // Convert tags vector to comma-separated string
-        std::string tagsStr;
-        const auto& tags = book.getTags();
-        for (size_t i = 0; i < tags.size(); ++i) {
-            tagsStr += tags[i];
-            if (i + 1 < tags.size()) tagsStr += ",";
-        }
-        sqlite3_bind_text(stmt, 5, tagsStr.c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(stmt, 6, book.getBookID().c_str(), -1, SQLITE_TRANSIENT);
-        bool success = (sqlite3_step(stmt) == SQLITE_DONE);
-        sqlite3_finalize(stmt);
-        return success;
+        auto lease = acquireWriter();
+        bool result = updateBook(*lease, book);
+        publishChanges(*lease);
+        return result;
+    }
+
+    bool Database::updateBook(Connection& conn, const Book& book) {
+        uint8_t fields = book.dirtyFields();
+        if (!fields) return true;   // Unchanged since it was loaded
+        touchBook(book.getBookID());
+        Transaction txn(conn.handle);
+        if (!txn.ok()) return false;
+        const std::string& sql = bookUpdateSql(fields);
+        if (!sql.empty()) {
+            sqlite3_stmt* stmt = prepare(conn, sql.c_str());
+            if (!stmt) return false;
+            StatementReset reset{stmt};
+            bindText(stmt, 1, book.getBookName());
+            bindText(stmt, 2, book.getAuthor());
+            bindText(stmt, 3, book.getPublicationYear());
+            bindId(stmt, 4, book.getCurrentUser());
+            bindId(stmt, 5, book.getBookID());
+            if (sqlite3_step(stmt) != SQLITE_DONE) return false;
+            // Leave book_tags alone for a book that does not exist
+            if (sqlite3_changes(conn.handle) == 0) return txn.commit();
+        } else {
+            // Only the tags changed; the same existence check without an UPDATE
+            std::string bookID = book.getBookID();
+            int rc = stepWith(prepare(conn, "SELECT 1 FROM books WHERE id = ?;"), {&bookID});
+            if (rc == SQLITE_DONE) return txn.commit();
+            if (rc != SQLITE_ROW) return false;
+        }
+        if (fields & Book::TagsField && !writeTags(conn, book.getBookID(), book.getTags())) return false;
+        return txn.commit();
     }
 
     Book Database::getBook(const std::string& bookID) const {
+        BookId id;
+        if (BookId::parse(bookID, id)) return getBook(id);
+        // Custom IDs bypass the cache
+        return loadBook([&](sqlite3_stmt* stmt) { bindId(stmt, 1, bookID); });
+    }
+
+    Book Database::getBook(const BookId& bookID) const {
         if (!connected) return Book("", "", "");
-        const char* sql = "SELECT id, name, author, year, currentUser, tags FROM books WHERE id = ?;";
-        sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) return Book("", "", "");
-        sqlite3_bind_text(stmt, 1, bookID.c_str(), -1, SQLITE_TRANSIENT);
         Book result("", "", "");
-        if (sqlite3_step(stmt) == SQLITE_ROW) {
-            result.setBookID(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
-            result.setBookName(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)));
-            result.setAuthor(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2)));
-            result.setPublicationYear(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3)));
-            result.setCurrentUser(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4)));
-            // Parse tags from comma-separated string
-            std::string tagsStr = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
-            std::vector<std::string> tags;
-            size_t start = 0, end = 0;
-            while ((end = tagsStr.find(',', start)) != std::string::npos) {
-                tags.push_back(tagsStr.substr(start, end - start));
-                start = end + 1;
+        if (bookCache) {
+            std::shared_lock<std::shared_mutex> lock(bookStringsMutex);
+            if (bookCache->read(bookID, [&](const CompactBook& cached) { result = cached.toBook(*bookStrings); }))
+                return result;
+        }
+        uint64_t epoch = cacheEpoch.load();
+        result = loadBook([&](sqlite3_stmt* stmt) { bindId(stmt, 1, bookID); });
+        // Misses are not cached: the row may be added by another connection later
+        if (bookCache && !result.getBookID().empty() && CompactBook::fits(result)) {
+            bool outgrown;
+            {
+                std::shared_lock<std::shared_mutex> lock(bookStringsMutex);
+                bookCache->putIf(bookID, CompactBook(result, *bookStrings), [&] { return cacheEpoch.load() == epoch; });
+                outgrown = bookStrings->memoryUsage() > bookStringsLimit;
             }
-            if (!tagsStr.empty() && start < tagsStr.size())
-                tags.push_back(tagsStr.substr(start));
-            result.setTags(tags);
+            if (outgrown) rebuildBookStrings();
         }
-        sqlite3_finalize(stmt);
+        return result;
+    }
+
+    Book Database::loadBook(const std::function<void(sqlite3_stmt*)>& bind) const {
+        Book result("", "", "");
+        if (!connected) return result;
+        const char* sql = "SELECT " LMS_BOOK_COLUMNS " FROM books WHERE id = ?;";
+        auto lease = acquireReader();
+        sqlite3_stmt* stmt = prepare(*lease, sql);
+        if (!stmt) return result;
+        StatementReset reset{stmt};
+        bind(stmt);
+        std::vector<std::string> tags;
+        if (sqlite3_step(stmt) == SQLITE_ROW) readBookRow(stmt, result, tags);
         return result;
     }
 
     std::vector<Book> Database::getAllBooks() const {
+        std::vector<Book> books;
+        forEachBook([&](const Book& book) {
+            books.push_back(book);
+            return true;
+        });
+        return books;
+    }
+
+    std::vector<Book> Database::selectBooks(const char* sql, const std::function<void(sqlite3_stmt*)>& bind) const {
         std::vector<Book> books;
         if (!connected) return books;
-        const char* sql = "SELECT id, name, author, year, currentUser, tags FROM books;";
-        sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) return books;
+        auto lease = acquireReader();
+        sqlite3_stmt* stmt = prepare(*lease, sql);
+        if (!stmt) return books;
+        StatementReset reset{stmt};
+        bind(stmt);
+        std::vector<std::string> tags;
         while (sqlite3_step(stmt) == SQLITE_ROW) {
-            Book b("", "", "");
-            b.setBookID(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
-            b.setBookName(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)));
-            b.setAuthor(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2)));
-            b.setPublicationYear(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3)));
-            b.setCurrentUser(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4)));
-            // Parse tags from comma-separated string
-            std::string tagsStr = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
-            std::vector<std::string> tags;
-            size_t start = 0, end = 0;
-            while ((end = tagsStr.find(',', start)) != std::string::npos) {
-                tags.push_back(tagsStr.substr(start, end - start));
-                start = end + 1;
+            books.emplace_back("", "", "");
+            readBookRow(stmt, books.back(), tags);
+        }
+        return books;
+    }
+
+    std::vector<Book> Database::listBooksAfter(const std::string& lastID, int limit) const {
+        // Keyset pagination: seeks straight to lastID in the primary key index
+        const char* sql = "SELECT " LMS_BOOK_COLUMNS " FROM books WHERE id > ? ORDER BY id LIMIT ?;";
+        return selectBooks(sql, [&](sqlite3_stmt* stmt) {
+            bindId(stmt, 1, lastID);
+            sqlite3_bind_int(stmt, 2, limit);
+        });
+    }
+
+    std::vector<Book> Database::findBooksByTag(const std::string& tag, int limit) const {
+        return findBooksByAllTags({tag}, limit);
+    }
+
+    std::vector<Book> Database::findBooksByAllTags(const std::vector<std::string>& tags, int limit) const {
+        if (tags.empty()) return {};
+        std::vector<std::string> distinctTags(tags);
+        std::sort(distinctTags.begin(), distinctTags.end());
+        distinctTags.erase(std::unique(distinctTags.begin(), distinctTags.end()), distinctTags.end());
+        // Each tag is a seek on idx_book_tags_tag; a book matches when it was found once per tag
+        std::string sql;
+        if (distinctTags.size() == 1) {
+            sql = "SELECT " LMS_BOOK_COLUMNS " FROM books WHERE id IN "
+                  "(SELECT book_id FROM book_tags WHERE tag = ?1) LIMIT ?2;";
+        } else {
+            sql = "SELECT " LMS_BOOK_COLUMNS " FROM books WHERE id IN "
+                  "(SELECT book_id FROM book_tags WHERE tag IN (?1";
+            for (size_t i = 1; i < distinctTags.size(); ++i)
+                sql += ", ?" + std::to_string(i + 1);
+            sql += ") GROUP BY book_id HAVING COUNT(*) = " + std::to_string(distinctTags.size()) + ") LIMIT ?"
+                 + std::to_string(distinctTags.size() + 1) + ";";
+        }
+        return selectBooks(sql.c_str(), [&](sqlite3_stmt* stmt) {
+            for (size_t i = 0; i < distinctTags.size(); ++i)
+                bindText(stmt, static_cast<int>(i + 1), distinctTags[i]);
+            sqlite3_bind_int(stmt, static_cast<int>(distinctTags.size() + 1), limit);
+        });
+    }
+
+    std::vector<std::string> Database::findBookIDsByTagQuery(const std::string& query, int limit) const {
+        TagQuery parsed;
+        if (!parseTagQuery(query, parsed)) return {};
+        if (tagPostings) return tagPostings->findBooks(parsed, limit);
+        std::vector<std::string> ids;
+        forEachBookView([&](const BookView& view) {
+            if (parsed.matches(view.tags)) ids.emplace_back(view.bookID);
+            return true;
+        });
+        std::sort(ids.begin(), ids.end());
+        if (limit >= 0 && ids.size() > static_cast<size_t>(limit)) ids.resize(static_cast<size_t>(limit));
+        return ids;
+    }
+
+    uint64_t Database::countBooksByTagQuery(const std::string& query) const {
+        TagQuery parsed;
+        if (!parseTagQuery(query, parsed)) return 0;
+        if (tagPostings) return tagPostings->count(parsed);
+        uint64_t count = 0;
+        forEachBookView([&](const BookView& view) {
+            count += parsed.matches(view.tags);
+            return true;
+        });
+        return count;
+    }
+
+    std::vector<Book> Database::findBooksByTagQuery(const std::string& query, int limit) const {
+        std::vector<std::string> ids = findBookIDsByTagQuery(query, limit);
+        std::vector<Book> books;
+        if (ids.empty() || !connected) return books;
+        books.reserve(ids.size());
+        // The last batch leaves its unused placeholders NULL, so every batch reuses one
+        // cached statement. A book removed since the lookup is simply not found.
+        auto lease = acquireReader();
+        sqlite3_stmt* stmt = prepare(*lease, bookBatchSql().c_str());
+        if (!stmt) return books;
+        std::vector<std::string> tags;
+        for (size_t first = 0; first < ids.size(); first += kBookBatch) {
+            StatementReset reset{stmt};
+            size_t count = std::min(kBookBatch, ids.size() - first);
+            for (size_t i = 0; i < count; ++i) bindId(stmt, static_cast<int>(i + 1), ids[first + i]);
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                books.emplace_back("", "", "");
+                readBookRow(stmt, books.back(), tags);
             }
-            if (!tagsStr.empty() && start < tagsStr.size())
-                tags.push_back(tagsStr.substr(start));
-            b.setTags(tags);
-            books.push_back(b);
         }
-        sqlite3_finalize(stmt);
+        // IN returns rows in index order, which puts text IDs after blobs
+        std::sort(books.begin(), books.end(),
+                  [](const Book& a, const Book& b) { return a.getBookID() < b.getBookID(); });
         return books;
     }
 
+    std::vector<Book> Database::findBooksByAuthor(const std::string& author, int limit) const {
+        const char* sql = "SELECT " LMS_BOOK_COLUMNS " FROM books WHERE author = ? LIMIT ?;";
+        return selectBooks(sql, [&](sqlite3_stmt* stmt) {
+            bindText(stmt, 1, author);
+            sqlite3_bind_int(stmt, 2, limit);
+        });
+    }
+
+    std::vector<Book> Database::findBooksByYearRange(int fromYear, int toYear, int limit) const {
+        // Must match the idx_books_year expression exactly for the index to be used
+        const char* sql = "SELECT " LMS_BOOK_COLUMNS " FROM books "
+                          "WHERE CAST(year AS INTEGER) BETWEEN ? AND ? ORDER BY CAST(year AS INTEGER) LIMIT ?;";
+        return selectBooks(sql, [&](sqlite3_stmt* stmt) {
+            sqlite3_bind_int(stmt, 1, fromYear);
+            sqlite3_bind_int(stmt, 2, toYear);
+            sqlite3_bind_int(stmt, 3, limit);
+        });
+    }
+
+    std::vector<Book> Database::findBooksBorrowedBy(const std::string& userID, int limit) const {
+        const char* sql = "SELECT " LMS_BOOK_COLUMNS " FROM books WHERE currentUser = ? LIMIT ?;";
+        return selectBooks(sql, [&](sqlite3_stmt* stmt) {
+            bindId(stmt, 1, userID);
+            sqlite3_bind_int(stmt, 2, limit);
+        });
+    }
+
+    std::vector<SearchResult> Database::searchBooks(const std::string& query, int limit) const {
+        std::vector<SearchResult> results;
+        if (!connected) return results;
+        // Quote every word so user input cannot inject FTS5 syntax, and match word
+        // prefixes so partial words still hit ("tolk ring")
+        std::string match;
+        size_t pos = 0;
+        while (pos < query.size()) {
+            while (pos < query.size() && std::isspace(static_cast<unsigned char>(query[pos]))) ++pos;
+            size_t end = pos;
+            while (end < query.size() && !std::isspace(static_cast<unsigned char>(query[end]))) ++end;
+            if (end == pos) break;
+            if (!match.empty()) match += ' ';
+            match += '"';
+            for (size_t i = pos; i < end; ++i) {
+                if (query[i] == '"') match += '"';
+                match += query[i];
+            }
+            match += "\"*";
+            pos = end;
+        }
+        if (match.empty()) return results;
+        const char* sql =
+            "SELECT " LMS_BOOK_COLUMNS ", books_fts.rank, snippet(books_fts, -1, '[', ']', '...', 12) "
+            "FROM books_fts JOIN books ON books.search_rowid = books_fts.rowid "
+            "WHERE books_fts MATCH ? ORDER BY books_fts.rank LIMIT ?;";
+        auto lease = acquireReader();
+        sqlite3_stmt* stmt = prepare(*lease, sql);
+        if (!stmt) return results;
+        StatementReset reset{stmt};
+        bindText(stmt, 1, match);
+        sqlite3_bind_int(stmt, 2, limit);
+        std::vector<std::string> tags;
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            results.push_back(SearchResult{Book("", "", ""), 0.0, ""});
+            SearchResult& result = results.back();
+            readBookRow(stmt, result.book, tags);
+            // FTS5 ranks are negative, lower is better; report a positive score
+            result.score = -sqlite3_column_double(stmt, 6);
+            result.snippet = columnText(stmt, 7);
+        }
+        return results;
+    }
+
+    bool Database::forEachBookView(const std::function<bool(const BookView&)>& visit) const {
+        if (!connected) return false;
+        const char* sql = "SELECT " LMS_BOOK_COLUMNS " FROM books;";
+        auto lease = acquireReader();
+        sqlite3_stmt* stmt = prepare(*lease, sql);
+        if (!stmt) return false;
+        StatementReset reset{stmt};
+        BookView view;
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            readBookView(stmt, view);
+            if (!visit(view)) return true;
+        }
+        return rc == SQLITE_DONE;
+    }
+
+    bool Database::forEachBook(const std::function<bool(const Book&)>& visit) const {
+        if (!connected) return false;
+        const char* sql = "SELECT " LMS_BOOK_COLUMNS " FROM books;";
+        auto lease = acquireReader();
+        sqlite3_stmt* stmt = prepare(*lease, sql);
+        if (!stmt) return false;
+        StatementReset reset{stmt};
+        // One Book is reused for every row, so memory stays flat however large the table is
+        Book book("", "", "");
+        std::vector<std::string> tags;
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            readBookRow(stmt, book, tags);
+            if (!visit(book)) return true;
+        }
+        return rc == SQLITE_DONE;
+    }
+
 
 
 
     // User operations
     bool Database::addUser(const User& user) {
         if (!connected) return false;
-        // Serialize borrowedBooks as comma-separated string
-        std::ostringstream oss;
-        for (size_t i = 0; i < user.getBorrowedBooks().size(); ++i) {
-            if (i > 0) oss << ",";
-            oss << user.getBorrowedBooks()[i];
-        }
-        std::string borrowedBooksStr = oss.str();
-        const char* sql = "INSERT INTO users (id, name, email, dob, address, borrowed_books, is_active) VALUES (?, ?, ?, ?, ?, ?, ?);";
-        sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) return false;
-        sqlite3_bind_text(stmt, 1, user.getUserID().c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(stmt, 2, user.getName().c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(stmt, 3, user.getEmail().c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(stmt, 4, user.getDOB().c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(stmt, 5, user.getAddress().c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(stmt, 6, borrowedBooksStr.c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_int(stmt, 7, user.active() ? 1 : 0);
-        bool success = (sqlite3_step(stmt) == SQLITE_DONE);
-        sqlite3_finalize(stmt);
-        return success;
+        auto lease = acquireWriter();
+        bool result = addUser(*lease, user);
+        publishChanges(*lease);
+        return result;
+    }
+
+    std::vector<bool> Database::addUsers(const std::vector<User>& users, size_t chunkSize) {
+        return insertInChunks(users.size(), chunkSize, [&](Connection& conn, size_t i) { return addUser(conn, users[i]); });
+    }
+
+    bool Database::addUser(Connection& conn, const User& user) {
+        touchUser(user.getUserID());
+        const char* sql = "INSERT INTO users (id, name, email, dob, address, is_active, content_hash) "
+                          "VALUES (?1, ?2, ?3, ?4, ?5, ?6, content_hash(?2, ?3, ?4, ?5));";
+        sqlite3_stmt* stmt = prepare(conn, sql);
+        if (!stmt) return false;
+        StatementReset reset{stmt};
+        bindId(stmt, 1, user.getUserID());
+        bindText(stmt, 2, user.getName());
+        bindText(stmt, 3, user.getEmail());
+        bindText(stmt, 4, user.getDOB());
+        bindText(stmt, 5, user.getAddress());
+        sqlite3_bind_int(stmt, 6, user.active() ? 1 : 0);
+        return sqlite3_step(stmt) == SQLITE_DONE;
     }
 
     bool Database::removeUser(const std::string& userID) {
         if (!connected) return false;
-        const char* sql = "DELETE FROM users WHERE id = ?;";
-        sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) return false;
-        sqlite3_bind_text(stmt, 1, userID.c_str(), -1, SQLITE_TRANSIENT);
-        bool success = (sqlite3_step(stmt) == SQLITE_DONE);
-        sqlite3_finalize(stmt);
-        return success;
+        auto lease = acquireWriter();
+        bool result = removeUser(*lease, userID);
+        publishChanges(*lease);
+        return result;
+    }
+
+    bool Database::removeUser(Connection& conn, const std::string& userID) {
+        touchUser(userID);
+        Transaction txn(conn.handle);
+        if (!txn.ok()) return false;
+        sqlite3_stmt* loans = prepare(conn, "SELECT " LMS_ID("book_id") " FROM loans WHERE user_id = ?;");
+        if (!loans) return false;
+        {
+            StatementReset reset{loans};
+            bindId(loans, 1, userID);
+            while (sqlite3_step(loans) == SQLITE_ROW)
+                touchBook(columnText(loans, 0));
+        }
+        // Books still on loan to the user become available again
+        for (const char* sql : {"UPDATE books SET currentUser = '' WHERE id IN (SELECT book_id FROM loans WHERE user_id = ?);",
+                                 "DELETE FROM loans WHERE user_id = ?;",
+                                 "DELETE FROM users WHERE id = ?;"}) {
+            sqlite3_stmt* stmt = prepare(conn, sql);
+            if (!stmt) return false;
+            StatementReset reset{stmt};
+            bindId(stmt, 1, userID);
+            if (sqlite3_step(stmt) != SQLITE_DONE) return false;
+        }
+        return txn.commit();
     }
 
     bool Database::updateUser(const User& user) {
         if (!connected) return false;
-        std::ostringstream oss;
-        for (size_t i = 0; i < user.getBorrowedBooks().size(); ++i) {
-            if (i > 0) oss << ",";
-            oss << user.getBorrowedBooks()[i];
-        }
-        std::string borrowedBooksStr = oss.str();
-        const char* sql = "UPDATE users SET name = ?, email = ?, dob = ?, address = ?, borrowed_books = ?, is_active = ? WHERE id = ?;";
-        sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) return false;
-        sqlite3_bind_text(stmt, 1, user.getName().c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(stmt, 2, user.getEmail().c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(stmt, 3, user.getDOB().c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(stmt, 4, user.getAddress().c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(stmt, 5, borrowedBooksStr.c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_int(stmt, 6, user.active() ? 1 : 0);
-        sqlite3_bind_text(stmt, 7, user.getUserID().c_str(), -1, SQLITE_TRANSIENT);
-        bool success = (sqlite3_step(stmt) == SQLITE_DONE);
-        sqlite3_finalize(stmt);
-        return success;
+        auto lease = acquireWriter();
+        bool result = updateUser(*lease, user);
+        publishChanges(*lease);
+        return result;
+    }
+
+    bool Database::updateUser(Connection& conn, const User& user) {
+        uint8_t fields = user.dirtyFields();
+        if (!fields) return true;   // Unchanged since it was loaded
+        touchUser(user.getUserID());
+        sqlite3_stmt* stmt = prepare(conn, userUpdateSql(fields).c_str());
+        if (!stmt) return false;
+        StatementReset reset{stmt};
+        bindText(stmt, 1, user.getName());
+        bindText(stmt, 2, user.getEmail());
+        bindText(stmt, 3, user.getDOB());
+        bindText(stmt, 4, user.getAddress());
+        sqlite3_bind_int(stmt, 5, user.active() ? 1 : 0);
+        bindId(stmt, 6, user.getUserID());
+        return sqlite3_step(stmt) == SQLITE_DONE;
+    }
+
+    LoanStatus Database::borrowBook(const std::string& userID, const std::string& bookID) {
+        if (!connected) return LoanStatus::Error;
+        auto lease = acquireWriter();
+        LoanStatus result = borrowBook(*lease, userID, bookID);
+        publishChanges(*lease);
+        return result;
+    }
+
+    LoanStatus Database::borrowBook(Connection& conn, const std::string& userID, const std::string& bookID) {
+        touchUser(userID);
+        touchBook(bookID);
+        Transaction txn(conn.handle);
+        if (!txn.ok()) return LoanStatus::Error;
+        int rc = stepWith(prepare(conn, "SELECT 1 FROM users WHERE id = ?;"), {&userID});
+        if (rc == SQLITE_DONE) return LoanStatus::UserNotFound;
+        if (rc != SQLITE_ROW) return LoanStatus::Error;
+        // Compare-and-set: only claims the book if nobody holds it
+        rc = stepWith(prepare(conn, "UPDATE books SET currentUser = ?1 WHERE id = ?2 AND (currentUser IS NULL OR currentUser = '');"),
+                      {&userID, &bookID});
+        if (rc != SQLITE_DONE) return LoanStatus::Error;
+        if (sqlite3_changes(conn.handle) == 0) {
+            rc = stepWith(prepare(conn, "SELECT 1 FROM books WHERE id = ?;"), {&bookID});
+            if (rc == SQLITE_ROW) return LoanStatus::Conflict;
+            return rc == SQLITE_DONE ? LoanStatus::BookNotFound : LoanStatus::Error;
+        }
+        sqlite3_stmt* loan = prepare(conn,
+            "INSERT INTO loans (user_id, book_id, borrowed_at, due_at) "
+            "VALUES (?1, ?2, CAST(strftime('%s', 'now') AS INTEGER), CAST(strftime('%s', 'now') AS INTEGER) + ?3);");
+        if (!loan) return LoanStatus::Error;
+        {
+            StatementReset reset{loan};
+            bindId(loan, 1, userID);
+            bindId(loan, 2, bookID);
+            sqlite3_bind_int(loan, 3, kLoanPeriodDays * 24 * 60 * 60);
+            if (sqlite3_step(loan) != SQLITE_DONE) return LoanStatus::Error;
+        }
+        return txn.commit() ? LoanStatus::Success : LoanStatus::Error;
+    }
+
+    LoanStatus Database::returnBook(const std::string& userID, const std::string& bookID) {
+        if (!connected) return LoanStatus::Error;
+        auto lease = acquireWriter();
+        LoanStatus result = returnBook(*lease, userID, bookID);
+        publishChanges(*lease);
+        return result;
+    }
+
+    LoanStatus Database::returnBook(Connection& conn, const std::string& userID, const std::string& bookID) {
+        touchUser(userID);
+        touchBook(bookID);
+        Transaction txn(conn.handle);
+        if (!txn.ok()) return LoanStatus::Error;
+        // Only the user holding the book can return it
+        int rc = stepWith(prepare(conn, "UPDATE books SET currentUser = '' WHERE id = ?2 AND currentUser = ?1;"),
+                          {&userID, &bookID});
+        if (rc != SQLITE_DONE) return LoanStatus::Error;
+        if (sqlite3_changes(conn.handle) == 0) {
+            rc = stepWith(prepare(conn, "SELECT 1 FROM books WHERE id = ?;"), {&bookID});
+            if (rc == SQLITE_ROW) return LoanStatus::NotBorrowed;
+            return rc == SQLITE_DONE ? LoanStatus::BookNotFound : LoanStatus::Error;
+        }
+        rc = stepWith(prepare(conn, "DELETE FROM loans WHERE user_id = ? AND book_id = ?;"), {&userID, &bookID});
+        if (rc != SQLITE_DONE) return LoanStatus::Error;
+        return txn.commit() ? LoanStatus::Success : LoanStatus::Error;
+    }
+
+    std::string Database::getBorrower(const std::string& bookID) const {
+        if (!connected) return "";
+        const char* sql = "SELECT " LMS_ID("user_id") " FROM loans WHERE book_id = ?;";
+        auto lease = acquireReader();
+        sqlite3_stmt* stmt = prepare(*lease, sql);
+        if (!stmt) return "";
+        StatementReset reset{stmt};
+        bindId(stmt, 1, bookID);
+        return sqlite3_step(stmt) == SQLITE_ROW ? columnText(stmt, 0) : "";
+    }
+
+    UserId Database::getBorrower(const BookId& bookID) const {
+        if (!connected) return UserId();
+        const char* sql = "SELECT user_id FROM loans WHERE book_id = ?;";
+        auto lease = acquireReader();
+        sqlite3_stmt* stmt = prepare(*lease, sql);
+        if (!stmt) return UserId();
+        StatementReset reset{stmt};
+        bindId(stmt, 1, bookID);
+        if (sqlite3_step(stmt) != SQLITE_ROW) return UserId();
+        if (sqlite3_column_type(stmt, 0) == SQLITE_BLOB && sqlite3_column_bytes(stmt, 0) == UserId::kSize)
+            return UserId::fromBytes(sqlite3_column_blob(stmt, 0));
+        return UserId::fromHex(columnText(stmt, 0));
     }
 
     User Database::getUser(const std::string& userID) const {
+        UserId id;
+        if (UserId::parse(userID, id)) return getUser(id);
+        return loadUser([&](sqlite3_stmt* stmt) { bindId(stmt, 1, userID); });
+    }
+
+    User Database::getUser(const UserId& userID) const {
         if (!connected) return User("", "");
-        const char* sql = "SELECT id, name, email, dob, address, borrowed_books, is_active FROM users WHERE id = ?;";
-        sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) return User("", "");
-        sqlite3_bind_text(stmt, 1, userID.c_str(), -1, SQLITE_TRANSIENT);
         User result("", "");
-        if (sqlite3_step(stmt) == SQLITE_ROW) {
-            result.setUserID(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
-            result.setName(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)));
-            result.setEmail(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2)));
-            result.setDOB(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3)));
-            result.setAddress(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4)));
-            // Parse borrowedBooks from comma-separated string
-            std::string borrowedBooksStr = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
-            std::vector<std::string> borrowedBooks;
-            std::istringstream iss(borrowedBooksStr);
-            std::string token;
-            while (std::getline(iss, token, ',')) {
-                if (!token.empty()) borrowedBooks.push_back(token);
-            }
-            result.setBorrowedBooks(borrowedBooks);
-            result.setActive(sqlite3_column_int(stmt, 6) != 0);
-        }
-        sqlite3_finalize(stmt);
+        if (userCache && userCache->get(userID, result)) return result;
+        uint64_t epoch = cacheEpoch.load();
+        result = loadUser([&](sqlite3_stmt* stmt) { bindId(stmt, 1, userID); });
+        if (userCache && !result.getUserID().empty())
+            userCache->putIf(userID, result, [&] { return cacheEpoch.load() == epoch; });
+        return result;
+    }
+
+    User Database::loadUser(const std::function<void(sqlite3_stmt*)>& bind) const {
+        User result("", "");
+        if (!connected) return result;
+        const char* sql = "SELECT " LMS_USER_COLUMNS " FROM users WHERE id = ?;";
+        auto lease = acquireReader();
+        sqlite3_stmt* stmt = prepare(*lease, sql);
+        if (!stmt) return result;
+        StatementReset reset{stmt};
+        bind(stmt);
+        if (sqlite3_step(stmt) == SQLITE_ROW) readUserRow(stmt, result);
         return result;
     }
 
     std::vector<User> Database::getAllUsers() const {
+        std::vector<User> users;
+        forEachUser([&](const User& user) {
+            users.push_back(user);
+            return true;
+        });
+        return users;
+    }
+
+    std::vector<User> Database::listUsersAfter(const std::string& lastID, int limit) const {
         std::vector<User> users;
         if (!connected) return users;
-        const char* sql = "SELECT id, name, email, dob, address, borrowed_books, is_active FROM users;";
-        sqlite3_stmt* stmt;
-        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) return users;
+        const char* sql = "SELECT " LMS_USER_COLUMNS " FROM users WHERE id > ? ORDER BY id LIMIT ?;";
+        auto lease = acquireReader();
+        sqlite3_stmt* stmt = prepare(*lease, sql);
+        if (!stmt) return users;
+        StatementReset reset{stmt};
+        bindId(stmt, 1, lastID);
+        sqlite3_bind_int(stmt, 2, limit);
         while (sqlite3_step(stmt) == SQLITE_ROW) {
-            User u("", "");
-            u.setUserID(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
-            u.setName(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)));
-            u.setEmail(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2)));
-            u.setDOB(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3)));
-            u.setAddress(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4)));
-            // Parse borrowedBooks from comma-separated string
-            std::string borrowedBooksStr = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
-            std::vector<std::string> borrowedBooks;
-            std::istringstream iss(borrowedBooksStr);
-            std::string token;
-            while (std::getline(iss, token, ',')) {
-                if (!token.empty()) borrowedBooks.push_back(token);
-            }
-            u.setBorrowedBooks(borrowedBooks);
-            u.setActive(sqlite3_column_int(stmt, 6) != 0);
-            users.push_back(u);
+            users.emplace_back("", "");
+            readUserRow(stmt, users.back());
         }
-        sqlite3_finalize(stmt);
         return users;
     }
+
+    bool Database::forEachUserView(const std::function<bool(const UserView&)>& visit) const {
+        if (!connected) return false;
+        const char* sql = "SELECT " LMS_USER_COLUMNS " FROM users;";
+        auto lease = acquireReader();
+        sqlite3_stmt* stmt = prepare(*lease, sql);
+        if (!stmt) return false;
+        StatementReset reset{stmt};
+        UserView view;
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            readUserView(stmt, view);
+            if (!visit(view)) return true;
+        }
+        return rc == SQLITE_DONE;
+    }
+
+    bool Database::forEachUser(const std::function<bool(const User&)>& visit) const {
+        if (!connected) return false;
+        const char* sql = "SELECT " LMS_USER_COLUMNS " FROM users;";
+        auto lease = acquireReader();
+        sqlite3_stmt* stmt = prepare(*lease, sql);
+        if (!stmt) return false;
+        StatementReset reset{stmt};
+        User user("", "");
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            readUserRow(stmt, user);
+            if (!visit(user)) return true;
+        }
+        return rc == SQLITE_DONE;
+    }
 } // namespace lms
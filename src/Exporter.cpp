@@ -0,0 +1,319 @@
+#include "../include/lms/Exporter.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+namespace lms {
+    namespace {
+        struct Column {
+            enum Kind : uint8_t { Text, List, Flag };
+            const char* name;
+            Kind kind;
+            char separator;     // How List values are joined in the database
+        };
+
+        const std::vector<Column> kBookColumns = {
+            {"id", Column::Text, 0}, {"name", Column::Text, 0}, {"author", Column::Text, 0},
+            {"year", Column::Text, 0}, {"current_user", Column::Text, 0}, {"tags", Column::List, kTagSeparator}};
+        const std::vector<Column> kUserColumns = {
+            {"id", Column::Text, 0}, {"name", Column::Text, 0}, {"email", Column::Text, 0}, {"dob", Column::Text, 0},
+            {"address", Column::Text, 0}, {"borrowed_books", Column::List, ','}, {"is_active", Column::Flag, 0}};
+
+        // One row as views into the cursor; flag holds the Flag column
+        struct Row {
+            std::array<std::string_view, 7> values;
+            bool flag = false;
+        };
+
+        // Formats rows of one table; begin/finish frame the file
+        class RowSink {
+        public:
+            RowSink(BufferedWriter& out, const std::vector<Column>& columns) : out(out), columns(columns) {}
+            virtual ~RowSink() = default;
+            virtual void begin() {}
+            virtual void row(const Row& row) = 0;
+            virtual void finish() {}
+        protected:
+            BufferedWriter& out;
+            const std::vector<Column>& columns;
+        };
+
+        class CsvSink : public RowSink {
+        public:
+            using RowSink::RowSink;
+
+            void begin() override {
+                for (size_t i = 0; i < columns.size(); ++i) {
+                    if (i) out.put(',');
+                    out.put(columns[i].name);
+                }
+                out.put('\n');
+            }
+
+            void row(const Row& row) override {
+                for (size_t i = 0; i < columns.size(); ++i) {
+                    if (i) out.put(',');
+                    const Column& column = columns[i];
+                    if (column.kind == Column::Flag) out.put(row.flag ? '1' : '0');
+                    else field(row.values[i], column.kind == Column::List ? column.separator : '\0');
+                }
+                out.put('\n');
+            }
+
+        private:
+            // Quotes the field only when it needs it. List items are joined by ';'
+            // instead of separator, and a ';' or backslash inside an item gets one more.
+            void field(std::string_view text, char separator) {
+                bool quote = text.find_first_of(",\"\r\n") != std::string_view::npos;
+                const char listSpecial[] = {separator, ';', '\\', '\0'};
+                if (!quote && (!separator || text.find_first_of(listSpecial) == std::string_view::npos)) {
+                    out.put(text);
+                    return;
+                }
+                if (quote) out.put('"');
+                for (char c : text) {
+                    if (c == '"') out.put('"');
+                    if (separator && c == separator) c = ';';
+                    else if (separator && (c == ';' || c == '\\')) out.put('\\');
+                    out.put(c);
+                }
+                if (quote) out.put('"');
+            }
+        };
+
+        class JsonLinesSink : public RowSink {
+        public:
+            using RowSink::RowSink;
+
+            void row(const Row& row) override {
+                out.put('{');
+                for (size_t i = 0; i < columns.size(); ++i) {
+                    const Column& column = columns[i];
+                    if (i) out.put(',');
+                    string(column.name);
+                    out.put(':');
+                    if (column.kind == Column::Text) {
+                        string(row.values[i]);
+                    } else if (column.kind == Column::Flag) {
+                        out.put(row.flag ? "true" : "false");
+                    } else {
+                        out.put('[');
+                        std::string_view list = row.values[i];
+                        size_t start = 0;
+                        while (start < list.size()) {
+                            size_t end = list.find(column.separator, start);
+                            if (end == std::string_view::npos) end = list.size();
+                            if (start) out.put(',');
+                            string(list.substr(start, end - start));
+                            start = end + 1;
+                        }
+                        out.put(']');
+                    }
+                }
+                out.put("}\n");
+            }
+
+        private:
+            void string(std::string_view text) {
+                static const char hex[] = "0123456789abcdef";
+                out.put('"');
+                // Copy runs of plain characters in one go, escaping only what must be
+                size_t start = 0;
+                for (size_t i = 0; i < text.size(); ++i) {
+                    unsigned char u = static_cast<unsigned char>(text[i]);
+                    if (u >= 0x20 && u != '"' && u != '\\') continue;
+                    out.put(text.substr(start, i - start));
+                    if (u < 0x20) {
+                        out.put("\\u00");
+                        out.put(hex[u >> 4]);
+                        out.put(hex[u & 0xF]);
+                    } else {
+                        out.put('\\');
+                        out.put(text[i]);
+                    }
+                    start = i + 1;
+                }
+                out.put(text.substr(start));
+                out.put('"');
+            }
+        };
+
+        // Buffers one row group column by column, then writes the chunks in column
+        // order. The buffers keep their capacity, so memory peaks at one row group.
+        class ColumnarSink : public RowSink {
+        public:
+            ColumnarSink(BufferedWriter& out, const std::vector<Column>& columns, size_t rowGroupRows)
+                : RowSink(out, columns), rowGroupRows(std::max<size_t>(1, rowGroupRows)), chunks(columns.size()) {}
+
+            void begin() override {
+                out.put("LMSC");
+                out.putLE32(Exporter::kColumnarVersion);
+            }
+
+            void row(const Row& row) override {
+                for (size_t i = 0; i < columns.size(); ++i) {
+                    ColumnChunk& chunk = chunks[i];
+                    if (columns[i].kind == Column::Flag) {
+                        chunk.bytes.push_back(row.flag ? 1 : 0);
+                    } else {
+                        chunk.lengths.push_back(static_cast<uint32_t>(row.values[i].size()));
+                        chunk.bytes.insert(chunk.bytes.end(), row.values[i].begin(), row.values[i].end());
+                    }
+                }
+                if (++pendingRows == rowGroupRows) flushRowGroup();
+            }
+
+            void finish() override {
+                if (pendingRows) flushRowGroup();
+                uint64_t footerStart = out.bytesWritten();
+                out.putLE32(static_cast<uint32_t>(columns.size()));
+                for (const Column& column : columns) {
+                    out.put(static_cast<char>(column.kind == Column::Flag ? 1 : 0));
+                    out.putLE32(static_cast<uint32_t>(std::strlen(column.name)));
+                    out.put(column.name);
+                }
+                out.putLE32(static_cast<uint32_t>(rowGroups.size()));
+                for (const RowGroup& group : rowGroups) {
+                    out.putLE32(group.rows);
+                    for (const auto& extent : group.extents) {
+                        out.putLE64(extent.first);
+                        out.putLE64(extent.second);
+                    }
+                }
+                out.putLE64(totalRows);
+                out.putLE32(static_cast<uint32_t>(out.bytesWritten() - footerStart));
+                out.put("LMSC");
+            }
+
+        private:
+            struct ColumnChunk {
+                std::vector<uint32_t> lengths;
+                std::vector<char> bytes;
+            };
+            struct RowGroup {
+                uint32_t rows;
+                std::vector<std::pair<uint64_t, uint64_t>> extents;    // Offset and size per column
+            };
+
+            void flushRowGroup() {
+                RowGroup group{static_cast<uint32_t>(pendingRows), {}};
+                for (size_t i = 0; i < columns.size(); ++i) {
+                    ColumnChunk& chunk = chunks[i];
+                    uint64_t start = out.bytesWritten();
+                    for (uint32_t length : chunk.lengths) out.putLE32(length);
+                    out.put(std::string_view(chunk.bytes.data(), chunk.bytes.size()));
+                    group.extents.emplace_back(start, out.bytesWritten() - start);
+                    chunk.lengths.clear();
+                    chunk.bytes.clear();
+                }
+                rowGroups.push_back(std::move(group));
+                totalRows += pendingRows;
+                pendingRows = 0;
+            }
+
+            size_t rowGroupRows;
+            size_t pendingRows = 0;
+            uint64_t totalRows = 0;
+            std::vector<ColumnChunk> chunks;
+            std::vector<RowGroup> rowGroups;
+        };
+    }
+
+    BufferedWriter::BufferedWriter(std::FILE* file, size_t capacity)
+        : file(file), buffer(std::max<size_t>(capacity, 64)) {}
+
+    BufferedWriter::~BufferedWriter() {
+        flush();
+    }
+
+    void BufferedWriter::put(std::string_view text) {
+        while (!text.empty()) {
+            if (used == buffer.size()) drain();
+            size_t n = std::min(text.size(), buffer.size() - used);
+            std::memcpy(buffer.data() + used, text.data(), n);
+            used += n;
+            text.remove_prefix(n);
+        }
+    }
+
+    void BufferedWriter::putLE32(uint32_t value) {
+        for (int i = 0; i < 4; ++i) put(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+
+    void BufferedWriter::putLE64(uint64_t value) {
+        for (int i = 0; i < 8; ++i) put(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+
+    void BufferedWriter::drain() {
+        if (used && !failed && std::fwrite(buffer.data(), 1, used, file) != used) failed = true;
+        written += used;
+        used = 0;
+    }
+
+    bool BufferedWriter::flush() {
+        drain();
+        if (!failed && std::fflush(file) != 0) failed = true;
+        return !failed;
+    }
+
+    Exporter::Exporter(const Database& db, const ExportOptions& options) : db(db), options(options) {}
+
+    bool Exporter::exportBooks(const std::string& path) {
+        return run(path, true);
+    }
+
+    bool Exporter::exportUsers(const std::string& path) {
+        return run(path, false);
+    }
+
+    bool Exporter::run(const std::string& path, bool books) {
+        auto started = std::chrono::steady_clock::now();
+        totals = ExportStats();
+        std::FILE* file = std::fopen(path.c_str(), "wb");
+        if (!file) {
+            std::cerr << "Can't open export file: " << path << std::endl;
+            return false;
+        }
+        // The writer does its own buffering
+        std::setvbuf(file, nullptr, _IONBF, 0);
+        bool ok;
+        {
+            BufferedWriter out(file, options.bufferBytes);
+            const std::vector<Column>& columns = books ? kBookColumns : kUserColumns;
+            std::unique_ptr<RowSink> sink;
+            switch (options.format) {
+                case ExportFormat::Csv: sink = std::make_unique<CsvSink>(out, columns); break;
+                case ExportFormat::JsonLines: sink = std::make_unique<JsonLinesSink>(out, columns); break;
+                default: sink = std::make_unique<ColumnarSink>(out, columns, options.rowGroupRows); break;
+            }
+            sink->begin();
+            Row row;
+            if (books) {
+                ok = db.forEachBookView([&](const BookView& book) {
+                    row.values = {book.bookID, book.name, book.author, book.year, book.currentUser, book.tags, {}};
+                    sink->row(row);
+                    ++totals.rows;
+                    return out.ok();
+                });
+            } else {
+                ok = db.forEachUserView([&](const UserView& user) {
+                    row.values = {user.userID, user.name, user.email, user.dob, user.address, user.borrowedBooks, {}};
+                    row.flag = user.isActive;
+                    sink->row(row);
+                    ++totals.rows;
+                    return out.ok();
+                });
+            }
+            sink->finish();
+            ok = out.flush() && ok;
+            totals.bytes = out.bytesWritten();
+        }
+        ok = std::fclose(file) == 0 && ok;
+        totals.elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        if (!ok) std::cerr << "Export to " << path << " failed" << std::endl;
+        return ok;
+    }
+}
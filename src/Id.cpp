@@ -0,0 +1,31 @@
+#include "../include/lms/Id.h"
+#include <atomic>
+#include <chrono>
+#include <random>
+
+namespace lms {
+    namespace {
+        // Last issued (milliseconds << 12 | counter); a counter overflow borrows the
+        // next millisecond, which keeps IDs increasing without waiting
+        std::atomic<uint64_t> lastTimestamp{0};
+    }
+
+    void generateTimeOrderedId(uint8_t* bytes) {
+        uint64_t now = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count()) << 12;
+        uint64_t last = lastTimestamp.load(std::memory_order_relaxed);
+        uint64_t next;
+        do {
+            next = now > last ? now : last + 1;
+        } while (!lastTimestamp.compare_exchange_weak(last, next, std::memory_order_relaxed));
+
+        thread_local std::mt19937_64 random(std::random_device{}());
+        uint64_t tail = random();
+        uint64_t millis = next >> 12;
+        for (int i = 0; i < 6; ++i) bytes[i] = static_cast<uint8_t>(millis >> (8 * (5 - i)));
+        bytes[6] = static_cast<uint8_t>(0x70 | ((next >> 8) & 0x0F));
+        bytes[7] = static_cast<uint8_t>(next);
+        bytes[8] = static_cast<uint8_t>(0x80 | ((tail >> 56) & 0x3F));
+        for (int i = 9; i < 16; ++i) bytes[i] = static_cast<uint8_t>(tail >> (8 * (15 - i)));
+    }
+}
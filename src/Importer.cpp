@@ -0,0 +1,534 @@
+#include "../include/lms/Importer.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace lms {
+    namespace {
+        // Blocking producer/consumer queue; push waits while it is full, and close()
+        // wakes everybody up (pop then drains what is left and returns false)
+        template <typename T>
+        class BoundedQueue {
+        public:
+            explicit BoundedQueue(size_t capacity) : capacity(std::max<size_t>(1, capacity)) {}
+
+            bool push(T item) {
+                std::unique_lock<std::mutex> lock(mutex);
+                notFull.wait(lock, [this] { return items.size() < capacity || closed; });
+                if (closed) return false;
+                items.push_back(std::move(item));
+                notEmpty.notify_one();
+                return true;
+            }
+
+            bool pop(T& item) {
+                std::unique_lock<std::mutex> lock(mutex);
+                notEmpty.wait(lock, [this] { return !items.empty() || closed; });
+                if (items.empty()) return false;
+                item = std::move(items.front());
+                items.pop_front();
+                notFull.notify_one();
+                return true;
+            }
+
+            void close() {
+                std::lock_guard<std::mutex> lock(mutex);
+                closed = true;
+                notFull.notify_all();
+                notEmpty.notify_all();
+            }
+
+        private:
+            size_t capacity;
+            std::deque<T> items;
+            bool closed = false;
+            std::mutex mutex;
+            std::condition_variable notFull;
+            std::condition_variable notEmpty;
+        };
+
+        enum Field { kId, kName, kAuthor, kYear, kTags, kEmail, kDob, kAddress, kActive, kFieldCount, kIgnored = -1 };
+
+        // One input record, whichever format it came from
+        struct Record {
+            std::array<std::string, kFieldCount> values;
+            std::vector<std::string> tags;
+
+            void clear() {
+                for (auto& value : values) value.clear();
+                tags.clear();
+            }
+        };
+
+        // The rows parsed from one chunk
+        struct ParsedChunk {
+            std::vector<Book> books;
+            std::vector<User> users;
+        };
+
+        std::string trimmed(std::string_view text) {
+            size_t start = 0, end = text.size();
+            while (start < end && std::isspace(static_cast<unsigned char>(text[start]))) ++start;
+            while (end > start && std::isspace(static_cast<unsigned char>(text[end - 1]))) --end;
+            return std::string(text.substr(start, end - start));
+        }
+
+        int fieldFor(std::string name, ImportKind kind) {
+            name = trimmed(name);
+            std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+            if (name == "id") return kId;
+            if (name == "name" || name == "title") return kName;
+            if (kind == ImportKind::Books) {
+                if (name == "author") return kAuthor;
+                if (name == "year" || name == "publication_year") return kYear;
+                if (name == "tags") return kTags;
+            } else {
+                if (name == "email") return kEmail;
+                if (name == "dob" || name == "date_of_birth") return kDob;
+                if (name == "address") return kAddress;
+                if (name == "is_active" || name == "active") return kActive;
+            }
+            return kIgnored;
+        }
+
+        // Tags are separated by ';'. A backslash makes the ';' or backslash after it
+        // part of the tag, as Exporter writes them; any other backslash is kept as is.
+        void splitTags(std::string_view text, std::vector<std::string>& tags) {
+            if (text.find('\\') == std::string_view::npos) {
+                size_t start = 0;
+                while (start <= text.size()) {
+                    size_t end = text.find(';', start);
+                    if (end == std::string_view::npos) end = text.size();
+                    std::string tag = trimmed(text.substr(start, end - start));
+                    if (!tag.empty()) tags.push_back(std::move(tag));
+                    start = end + 1;
+                }
+                return;
+            }
+            std::string tag;
+            for (size_t i = 0; i <= text.size(); ++i) {
+                if (i == text.size() || text[i] == ';') {
+                    tag = trimmed(tag);
+                    if (!tag.empty()) tags.push_back(std::move(tag));
+                    tag.clear();
+                    continue;
+                }
+                if (text[i] == '\\' && i + 1 < text.size() && (text[i + 1] == ';' || text[i + 1] == '\\')) ++i;
+                tag += text[i];
+            }
+        }
+
+        // Length of the longest prefix of data made of whole records. CSV records may
+        // contain quoted newlines, so quotes are tracked ("" toggles twice).
+        size_t completeRecords(const std::string& data, ImportFormat format) {
+            if (format == ImportFormat::JsonLines) {
+                size_t newline = data.rfind('\n');
+                return newline == std::string::npos ? 0 : newline + 1;
+            }
+            bool quoted = false;
+            size_t end = 0;
+            for (size_t i = 0; i < data.size(); ++i) {
+                char c = data[i];
+                if (c == '"') quoted = !quoted;
+                else if (c == '\n' && !quoted) end = i + 1;
+            }
+            return end;
+        }
+
+        // Reads one RFC 4180 record starting at pos (quoted fields, "" escapes, LF or
+        // CRLF line ends) and leaves pos at the start of the next one
+        void readCsvRecord(std::string_view data, size_t& pos, std::vector<std::string>& fields) {
+            fields.clear();
+            std::string field;
+            bool quoted = false;
+            while (pos < data.size()) {
+                char c = data[pos++];
+                if (quoted) {
+                    if (c != '"') field += c;
+                    else if (pos < data.size() && data[pos] == '"') field += data[pos++];
+                    else quoted = false;
+                } else if (c == '"') {
+                    quoted = true;
+                } else if (c == ',') {
+                    fields.push_back(std::move(field));
+                    field.clear();
+                } else if (c == '\n') {
+                    break;
+                } else if (c != '\r') {
+                    field += c;
+                }
+            }
+            fields.push_back(std::move(field));
+        }
+
+        // Just enough JSON to read one flat object per line. Nested objects and arrays
+        // are skipped, except a string array under "tags".
+        class JsonReader {
+        public:
+            explicit JsonReader(std::string_view text) : text(text) {}
+
+            bool readObject(Record& record, ImportKind kind) {
+                skipSpace();
+                if (!consume('{')) return false;
+                skipSpace();
+                if (consume('}')) return atEnd();
+                std::string key;
+                while (true) {
+                    skipSpace();
+                    if (!readString(key)) return false;
+                    skipSpace();
+                    if (!consume(':')) return false;
+                    skipSpace();
+                    int field = fieldFor(key, kind);
+                    bool ok;
+                    if (field == kTags && peek() == '[') ok = readTags(record.tags);
+                    else if (field != kIgnored && peek() != '{' && peek() != '[') ok = readScalar(record.values[field]);
+                    else ok = skipValue();
+                    if (!ok) return false;
+                    if (field == kTags && !record.values[kTags].empty()) splitTags(record.values[kTags], record.tags);
+                    skipSpace();
+                    if (consume('}')) return atEnd();
+                    if (!consume(',')) return false;
+                }
+            }
+
+        private:
+            char peek() const { return pos < text.size() ? text[pos] : '\0'; }
+            bool consume(char c) {
+                if (peek() != c) return false;
+                ++pos;
+                return true;
+            }
+            void skipSpace() {
+                while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) ++pos;
+            }
+            bool atEnd() {
+                skipSpace();
+                return pos == text.size();
+            }
+
+            static void appendUtf8(std::string& out, uint32_t code) {
+                if (code < 0x80) {
+                    out += static_cast<char>(code);
+                } else if (code < 0x800) {
+                    out += static_cast<char>(0xC0 | (code >> 6));
+                    out += static_cast<char>(0x80 | (code & 0x3F));
+                } else if (code < 0x10000) {
+                    out += static_cast<char>(0xE0 | (code >> 12));
+                    out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                    out += static_cast<char>(0x80 | (code & 0x3F));
+                } else {
+                    out += static_cast<char>(0xF0 | (code >> 18));
+                    out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+                    out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                    out += static_cast<char>(0x80 | (code & 0x3F));
+                }
+            }
+
+            bool readHex4(uint32_t& code) {
+                if (pos + 4 > text.size()) return false;
+                code = 0;
+                for (int i = 0; i < 4; ++i) {
+                    char c = text[pos++];
+                    code <<= 4;
+                    if (c >= '0' && c <= '9') code |= c - '0';
+                    else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+                    else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+                    else return false;
+                }
+                return true;
+            }
+
+            bool readString(std::string& out) {
+                out.clear();
+                if (!consume('"')) return false;
+                while (pos < text.size()) {
+                    char c = text[pos++];
+                    if (c == '"') return true;
+                    if (c != '\\') {
+                        out += c;
+                        continue;
+                    }
+                    if (pos >= text.size()) return false;
+                    switch (text[pos++]) {
+                        case '"': out += '"'; break;
+                        case '\\': out += '\\'; break;
+                        case '/': out += '/'; break;
+                        case 'b': out += '\b'; break;
+                        case 'f': out += '\f'; break;
+                        case 'n': out += '\n'; break;
+                        case 'r': out += '\r'; break;
+                        case 't': out += '\t'; break;
+                        case 'u': {
+                            uint32_t code;
+                            if (!readHex4(code)) return false;
+                            // A high surrogate followed by \uDC00-\uDFFF encodes one code point
+                            if (code >= 0xD800 && code < 0xDC00 && text.substr(pos, 2) == "\\u") {
+                                size_t mark = pos;
+                                pos += 2;
+                                uint32_t low;
+                                if (readHex4(low) && low >= 0xDC00 && low < 0xE000)
+                                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                                else
+                                    pos = mark;
+                            }
+                            appendUtf8(out, code);
+                            break;
+                        }
+                        default: return false;
+                    }
+                }
+                return false;
+            }
+
+            // Strings are unescaped; numbers and true/false are kept as written; null is ""
+            bool readScalar(std::string& out) {
+                if (peek() == '"') return readString(out);
+                size_t start = pos;
+                while (pos < text.size() && text[pos] != ',' && text[pos] != '}' && text[pos] != ']' &&
+                       !std::isspace(static_cast<unsigned char>(text[pos])))
+                    ++pos;
+                if (pos == start) return false;
+                std::string_view literal = text.substr(start, pos - start);
+                out = literal == "null" ? "" : std::string(literal);
+                return true;
+            }
+
+            bool readTags(std::vector<std::string>& tags) {
+                consume('[');
+                skipSpace();
+                if (consume(']')) return true;
+                std::string tag;
+                while (true) {
+                    skipSpace();
+                    if (!readScalar(tag)) return false;
+                    if (!tag.empty()) tags.push_back(tag);
+                    skipSpace();
+                    if (consume(']')) return true;
+                    if (!consume(',')) return false;
+                }
+            }
+
+            bool skipValue() {
+                char c = peek();
+                if (c == '"') {
+                    std::string ignored;
+                    return readString(ignored);
+                }
+                if (c != '{' && c != '[') {
+                    std::string ignored;
+                    return readScalar(ignored);
+                }
+                int depth = 0;
+                std::string ignored;
+                while (pos < text.size()) {
+                    c = text[pos];
+                    if (c == '"') {
+                        if (!readString(ignored)) return false;
+                        continue;
+                    }
+                    ++pos;
+                    if (c == '{' || c == '[') ++depth;
+                    else if ((c == '}' || c == ']') && --depth == 0) return true;
+                }
+                return false;
+            }
+
+            std::string_view text;
+            size_t pos = 0;
+        };
+
+        bool parseActive(const std::string& text) {
+            std::string value = trimmed(text);
+            return !(value == "0" || value == "false" || value == "FALSE" || value == "False" || value == "no");
+        }
+
+        // Turns a record into a row; false if it has no name
+        bool addRow(Record& record, ImportKind kind, ParsedChunk& out) {
+            auto& v = record.values;
+            std::string name = trimmed(v[kName]);
+            if (name.empty()) return false;
+            std::string id = trimmed(v[kId]);
+            if (kind == ImportKind::Books) {
+                Book book(std::move(name), trimmed(v[kAuthor]), trimmed(v[kYear]));
+                book.setTags(std::move(record.tags));
+                book.setBookID(std::move(id));
+                out.books.push_back(std::move(book));
+            } else {
+                User user(std::move(name), trimmed(v[kEmail]), trimmed(v[kDob]), trimmed(v[kAddress]));
+                if (!v[kActive].empty()) user.setActive(parseActive(v[kActive]));
+                user.setUserID(std::move(id));
+                out.users.push_back(std::move(user));
+            }
+            return true;
+        }
+    }
+
+    Importer::Importer(Database& db, const ImportOptions& options) : db(db), options(options) {}
+
+    bool Importer::run(const std::string& path) {
+        using Clock = std::chrono::steady_clock;
+        auto started = Clock::now();
+        totals = ImportProgress();
+
+        std::ifstream input(path, std::ios::binary);
+        if (!input) {
+            std::cerr << "Can't open import file: " << path << std::endl;
+            return false;
+        }
+        input.seekg(0, std::ios::end);
+        totals.totalBytes = static_cast<uint64_t>(std::max<std::streamoff>(0, input.tellg()));
+        input.seekg(0, std::ios::beg);
+
+        size_t chunkBytes = std::max<size_t>(options.chunkBytes, 4096);
+        size_t parserCount = options.parserThreads ? options.parserThreads : std::max(1u, std::thread::hardware_concurrency());
+        std::atomic<uint64_t> bytesRead{0}, rowsParsed{0}, rowsMalformed{0};
+        bool readFailed = false;
+
+        // The first chunk is read here so the CSV header is known before parsing starts
+        std::string pending(chunkBytes, '\0');
+        input.read(&pending[0], static_cast<std::streamsize>(chunkBytes));
+        pending.resize(static_cast<size_t>(input.gcount()));
+        bytesRead += pending.size();
+        readFailed = input.bad();
+        if (pending.compare(0, 3, "\xEF\xBB\xBF") == 0) pending.erase(0, 3);
+
+        std::vector<int> columns;
+        if (options.format == ImportFormat::Csv) {
+            if (options.csvHeader) {
+                size_t pos = 0;
+                std::vector<std::string> header;
+                readCsvRecord(pending, pos, header);
+                for (const auto& name : header) columns.push_back(fieldFor(name, options.kind));
+                pending.erase(0, pos);
+            } else if (options.kind == ImportKind::Books) {
+                columns = {kName, kAuthor, kYear, kTags};
+            } else {
+                columns = {kName, kEmail, kDob, kAddress};
+            }
+        }
+
+        BoundedQueue<std::string> chunks(parserCount * 2);
+        BoundedQueue<ParsedChunk> parsed(parserCount * 2);
+
+        // Stage 1: cut the input into chunks that end on a record boundary
+        std::thread reader([&] {
+            std::string buffer = std::move(pending);
+            bool eof = !input;
+            while (true) {
+                size_t cut = eof ? buffer.size() : completeRecords(buffer, options.format);
+                if (cut > 0) {
+                    // Hand over the buffer itself and keep only the partial record
+                    std::string chunk;
+                    chunk.swap(buffer);
+                    buffer.assign(chunk, cut, std::string::npos);
+                    chunk.resize(cut);
+                    if (!chunks.push(std::move(chunk))) break;
+                }
+                if (eof) break;
+                size_t old = buffer.size();
+                buffer.resize(old + chunkBytes);
+                input.read(&buffer[old], static_cast<std::streamsize>(chunkBytes));
+                size_t got = static_cast<size_t>(input.gcount());
+                buffer.resize(old + got);
+                bytesRead += got;
+                if (!input) {
+                    eof = true;
+                    readFailed = input.bad();
+                }
+            }
+            chunks.close();
+        });
+
+        // Stage 2: parse chunks and generate IDs on every core
+        std::atomic<size_t> parsersLeft{parserCount};
+        std::vector<std::thread> parsers;
+        for (size_t i = 0; i < parserCount; ++i) {
+            parsers.emplace_back([&] {
+                std::string chunk;
+                std::vector<std::string> fields;
+                Record record;
+                while (chunks.pop(chunk)) {
+                    ParsedChunk out;
+                    std::string_view data(chunk);
+                    size_t pos = 0;
+                    while (pos < data.size()) {
+                        record.clear();
+                        bool ok;
+                        if (options.format == ImportFormat::Csv) {
+                            readCsvRecord(data, pos, fields);
+                            if (fields.size() == 1 && trimmed(fields[0]).empty()) continue;
+                            for (size_t col = 0; col < fields.size() && col < columns.size(); ++col)
+                                if (columns[col] != kIgnored) record.values[columns[col]] = std::move(fields[col]);
+                            splitTags(record.values[kTags], record.tags);
+                            ok = fields.size() <= columns.size();
+                        } else {
+                            size_t end = data.find('\n', pos);
+                            if (end == std::string_view::npos) end = data.size();
+                            std::string_view line = data.substr(pos, end - pos);
+                            pos = end + 1;
+                            if (trimmed(line).empty()) continue;
+                            ok = JsonReader(line).readObject(record, options.kind);
+                        }
+                        if (ok && addRow(record, options.kind, out)) ++rowsParsed;
+                        else ++rowsMalformed;
+                    }
+                    // Rows without an id get one generated, content hashes a batch at a time
+                    Book::generateIDs(out.books, options.idStrategy);
+                    User::generateIDs(out.users, options.idStrategy);
+                    // Inserting in key order keeps the writer on neighbouring B-tree pages
+                    std::sort(out.books.begin(), out.books.end(),
+                              [](const Book& a, const Book& b) { return a.getBookID() < b.getBookID(); });
+                    std::sort(out.users.begin(), out.users.end(),
+                              [](const User& a, const User& b) { return a.getUserID() < b.getUserID(); });
+                    if (!parsed.push(std::move(out))) break;
+                }
+                if (--parsersLeft == 0) parsed.close();
+            });
+        }
+
+        // Stage 3: a single writer, since SQLite takes one writer at a time anyway
+        auto snapshot = [&] {
+            totals.bytesRead = bytesRead;
+            totals.rowsParsed = rowsParsed;
+            totals.rowsMalformed = rowsMalformed;
+            totals.elapsedSeconds = std::chrono::duration<double>(Clock::now() - started).count();
+        };
+        auto lastReport = started;
+        ParsedChunk batch;
+        while (parsed.pop(batch)) {
+            std::vector<bool> status = options.kind == ImportKind::Books
+                ? db.addBooks(batch.books, options.batchSize)
+                : db.addUsers(batch.users, options.batchSize);
+            size_t inserted = static_cast<size_t>(std::count(status.begin(), status.end(), true));
+            totals.rowsInserted += inserted;
+            totals.rowsRejected += status.size() - inserted;
+            auto now = Clock::now();
+            if (options.onProgress && std::chrono::duration<double>(now - lastReport).count() >= options.progressInterval) {
+                lastReport = now;
+                snapshot();
+                options.onProgress(totals);
+            }
+        }
+
+        reader.join();
+        for (auto& parser : parsers) parser.join();
+        snapshot();
+        if (options.onProgress) options.onProgress(totals);
+        if (readFailed) {
+            std::cerr << "Error reading import file: " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,367 @@
+#include "../include/lms/MappedCatalog.h"
+#include "../include/lms/Database.h"
+#include "../include/lms/Exporter.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <unordered_map>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace lms {
+    // The on-disk structures are used in place, so they only hold fixed-width
+    // little-endian fields at their natural alignment
+    struct MappedCatalog::StringRef {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    struct MappedCatalog::BookRecord {
+        StringRef name;
+        StringRef author;
+        StringRef year;
+        StringRef currentUser;
+        StringRef tags;
+    };
+
+    struct MappedCatalog::TagEntry {
+        StringRef name;
+        uint32_t postingsBegin;
+        uint32_t postingsCount;
+    };
+
+    struct MappedCatalog::Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint32_t idWidth;
+        uint64_t bookCount;
+        uint64_t tagCount;
+        uint64_t postingCount;
+        uint64_t idsOffset;
+        uint64_t recordsOffset;
+        uint64_t authorsOffset;
+        uint64_t tagsOffset;
+        uint64_t postingsOffset;
+        uint64_t heapOffset;
+        uint64_t heapSize;
+    };
+
+    namespace {
+        const char kMagic[4] = {'L', 'M', 'S', 'S'};
+        // Reads back as this value only on a host with the writer's (little-endian) byte order
+        const uint32_t kByteOrderMark = 0x01020304;
+
+        uint64_t align8(uint64_t offset) {
+            return (offset + 7) & ~uint64_t(7);
+        }
+
+        void pad(BufferedWriter& out, uint64_t offset) {
+            while (out.bytesWritten() < offset) out.put('\0');
+        }
+    }
+
+    bool MappedCatalog::write(const Database& db, const std::string& path) {
+        static_assert(sizeof(StringRef) == 8 && sizeof(BookRecord) == 40 && sizeof(TagEntry) == 16 && sizeof(Header) == 96,
+                      "on-disk structures must not contain padding");
+        // Strings are interned so repeated authors, years and tag lists are stored once
+        std::string heap;
+        std::unordered_map<std::string, StringRef> interned;
+        bool heapFull = false;
+        auto intern = [&](std::string_view value) {
+            auto it = interned.find(std::string(value));
+            if (it != interned.end()) return it->second;
+            if (heap.size() + value.size() > UINT32_MAX) heapFull = true;
+            StringRef ref{static_cast<uint32_t>(heap.size()), static_cast<uint32_t>(value.size())};
+            heap.append(value.data(), value.size());
+            interned.emplace(std::string(value), ref);
+            return ref;
+        };
+
+        std::vector<std::string> ids;
+        std::vector<BookRecord> rows;
+        std::map<std::string, std::vector<uint32_t>> tagRows;
+        size_t idWidth = 1;
+        bool ok = db.forEachBookView([&](const BookView& book) {
+            uint32_t row = static_cast<uint32_t>(rows.size());
+            ids.emplace_back(book.bookID);
+            idWidth = std::max(idWidth, book.bookID.size());
+            rows.push_back(BookRecord{intern(book.name), intern(book.author), intern(book.year),
+                                      intern(book.currentUser), intern(book.tags)});
+            book.forEachTag([&](std::string_view tag) { tagRows[std::string(tag)].push_back(row); });
+            return true;
+        });
+        for (const auto& entry : tagRows) intern(entry.first);
+        if (!ok || heapFull || rows.size() > UINT32_MAX) {
+            std::cerr << "Can't build catalog snapshot" << (heapFull ? ": string heap exceeds 4 GiB" : "") << std::endl;
+            return false;
+        }
+
+        // Ordinals follow ID order; ordinalOf maps scan order to it
+        size_t count = rows.size();
+        std::vector<uint32_t> byID(count);
+        std::iota(byID.begin(), byID.end(), 0);
+        std::sort(byID.begin(), byID.end(), [&](uint32_t a, uint32_t b) { return ids[a] < ids[b]; });
+        std::vector<uint32_t> ordinalOf(count);
+        for (uint32_t ordinal = 0; ordinal < count; ++ordinal) ordinalOf[byID[ordinal]] = ordinal;
+
+        std::vector<uint32_t> byAuthor(count);
+        std::iota(byAuthor.begin(), byAuthor.end(), 0);
+        auto authorOf = [&](uint32_t ordinal) {
+            const StringRef& ref = rows[byID[ordinal]].author;
+            return std::string_view(heap.data() + ref.offset, ref.length);
+        };
+        std::stable_sort(byAuthor.begin(), byAuthor.end(), [&](uint32_t a, uint32_t b) { return authorOf(a) < authorOf(b); });
+
+        uint64_t postingCount = 0;
+        for (const auto& entry : tagRows) postingCount += entry.second.size();
+
+        Header header{};
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kVersion;
+        header.byteOrder = kByteOrderMark;
+        header.idWidth = static_cast<uint32_t>(idWidth);
+        header.bookCount = count;
+        header.tagCount = tagRows.size();
+        header.postingCount = postingCount;
+        header.idsOffset = align8(sizeof(Header));
+        header.recordsOffset = align8(header.idsOffset + count * idWidth);
+        header.authorsOffset = align8(header.recordsOffset + count * sizeof(BookRecord));
+        header.tagsOffset = align8(header.authorsOffset + count * sizeof(uint32_t));
+        header.postingsOffset = align8(header.tagsOffset + tagRows.size() * sizeof(TagEntry));
+        header.heapOffset = align8(header.postingsOffset + postingCount * sizeof(uint32_t));
+        header.heapSize = heap.size();
+
+        std::string tempPath = path + ".tmp";
+        std::FILE* file = std::fopen(tempPath.c_str(), "wb");
+        if (!file) {
+            std::cerr << "Can't open snapshot file: " << tempPath << std::endl;
+            return false;
+        }
+        std::setvbuf(file, nullptr, _IONBF, 0);
+        {
+            BufferedWriter out(file, 1 << 20);
+            auto putRef = [&](const StringRef& ref) {
+                out.putLE32(ref.offset);
+                out.putLE32(ref.length);
+            };
+            out.put(std::string_view(header.magic, sizeof(header.magic)));
+            out.putLE32(header.version);
+            out.putLE32(header.byteOrder);
+            out.putLE32(header.idWidth);
+            for (uint64_t value : {header.bookCount, header.tagCount, header.postingCount, header.idsOffset,
+                                   header.recordsOffset, header.authorsOffset, header.tagsOffset,
+                                   header.postingsOffset, header.heapOffset, header.heapSize})
+                out.putLE64(value);
+
+            pad(out, header.idsOffset);
+            for (uint32_t row : byID) {
+                out.put(ids[row]);
+                for (size_t i = ids[row].size(); i < idWidth; ++i) out.put('\0');
+            }
+            pad(out, header.recordsOffset);
+            for (uint32_t row : byID) {
+                const BookRecord& record = rows[row];
+                for (const StringRef* ref : {&record.name, &record.author, &record.year, &record.currentUser, &record.tags})
+                    putRef(*ref);
+            }
+            pad(out, header.authorsOffset);
+            for (uint32_t ordinal : byAuthor) out.putLE32(ordinal);
+            pad(out, header.tagsOffset);
+            uint32_t postingsBegin = 0;
+            for (const auto& entry : tagRows) {
+                putRef(interned[entry.first]);
+                out.putLE32(postingsBegin);
+                out.putLE32(static_cast<uint32_t>(entry.second.size()));
+                postingsBegin += static_cast<uint32_t>(entry.second.size());
+            }
+            pad(out, header.postingsOffset);
+            std::vector<uint32_t> postings;
+            for (const auto& entry : tagRows) {
+                postings.clear();
+                for (uint32_t row : entry.second) postings.push_back(ordinalOf[row]);
+                std::sort(postings.begin(), postings.end());
+                for (uint32_t ordinal : postings) out.putLE32(ordinal);
+            }
+            pad(out, header.heapOffset);
+            out.put(heap);
+            ok = out.flush();
+        }
+        ok = std::fclose(file) == 0 && ok;
+#ifdef _WIN32
+        // rename() does not replace an existing file on Windows
+        if (ok) std::remove(path.c_str());
+#endif
+        if (!ok || std::rename(tempPath.c_str(), path.c_str()) != 0) {
+            std::cerr << "Error writing snapshot file: " << path << std::endl;
+            std::remove(tempPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    MappedCatalog::~MappedCatalog() {
+        close();
+    }
+
+    bool MappedCatalog::open(const std::string& path) {
+        close();
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            std::cerr << "Can't open snapshot file: " << path << std::endl;
+            return false;
+        }
+        LARGE_INTEGER fileSize;
+        HANDLE mapping = nullptr;
+        if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (!view) {
+            std::cerr << "Can't map snapshot file: " << path << std::endl;
+            if (mapping) CloseHandle(mapping);
+            CloseHandle(file);
+            return false;
+        }
+        fileHandle = file;
+        mappingHandle = mapping;
+        size = static_cast<size_t>(fileSize.QuadPart);
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Can't open snapshot file: " << path << std::endl;
+            return false;
+        }
+        struct stat info;
+        void* view = MAP_FAILED;
+        if (fstat(fd, &info) == 0 && info.st_size > 0)
+            view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        if (view == MAP_FAILED) {
+            std::cerr << "Can't map snapshot file: " << path << std::endl;
+            ::close(fd);
+            fd = -1;
+            return false;
+        }
+        size = static_cast<size_t>(info.st_size);
+#endif
+        base = static_cast<const char*>(view);
+
+        // Only the header is checked; the sections are trusted as written
+        const Header* candidate = reinterpret_cast<const Header*>(base);
+        bool valid = size >= sizeof(Header) && std::memcmp(candidate->magic, kMagic, sizeof(kMagic)) == 0 &&
+                     candidate->version == kVersion && candidate->byteOrder == kByteOrderMark &&
+                     candidate->idWidth > 0 && candidate->heapOffset + candidate->heapSize <= size &&
+                     candidate->idsOffset + candidate->bookCount * candidate->idWidth <= candidate->recordsOffset &&
+                     candidate->recordsOffset + candidate->bookCount * sizeof(BookRecord) <= candidate->authorsOffset &&
+                     candidate->authorsOffset + candidate->bookCount * sizeof(uint32_t) <= candidate->tagsOffset &&
+                     candidate->tagsOffset + candidate->tagCount * sizeof(TagEntry) <= candidate->postingsOffset &&
+                     candidate->postingsOffset + candidate->postingCount * sizeof(uint32_t) <= candidate->heapOffset;
+        if (!valid) {
+            std::cerr << "Not a catalog snapshot (or written by another version): " << path << std::endl;
+            close();
+            return false;
+        }
+        header = candidate;
+        return true;
+    }
+
+    void MappedCatalog::close() {
+        if (!base) return;
+#ifdef _WIN32
+        UnmapViewOfFile(base);
+        CloseHandle(static_cast<HANDLE>(mappingHandle));
+        CloseHandle(static_cast<HANDLE>(fileHandle));
+        mappingHandle = fileHandle = nullptr;
+#else
+        munmap(const_cast<char*>(base), size);
+        ::close(fd);
+        fd = -1;
+#endif
+        base = nullptr;
+        header = nullptr;
+        size = 0;
+    }
+
+    std::string_view MappedCatalog::text(const StringRef& ref) const {
+        return std::string_view(base + header->heapOffset + ref.offset, ref.length);
+    }
+
+    std::string_view MappedCatalog::idAt(size_t ordinal) const {
+        const char* slot = base + header->idsOffset + ordinal * header->idWidth;
+        return std::string_view(slot, std::find(slot, slot + header->idWidth, '\0') - slot);
+    }
+
+    size_t MappedCatalog::bookCount() const {
+        return header ? static_cast<size_t>(header->bookCount) : 0;
+    }
+
+    BookView MappedCatalog::bookAt(size_t ordinal) const {
+        const BookRecord& record = reinterpret_cast<const BookRecord*>(base + header->recordsOffset)[ordinal];
+        BookView view;
+        view.bookID = idAt(ordinal);
+        view.name = text(record.name);
+        view.author = text(record.author);
+        view.year = text(record.year);
+        view.currentUser = text(record.currentUser);
+        view.tags = text(record.tags);
+        view.isAvailable = view.currentUser.empty();
+        return view;
+    }
+
+    bool MappedCatalog::findBook(std::string_view bookID, BookView& out) const {
+        size_t low = 0, high = bookCount();
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+            if (idAt(middle) < bookID) low = middle + 1;
+            else high = middle;
+        }
+        if (low == bookCount() || idAt(low) != bookID) return false;
+        out = bookAt(low);
+        return true;
+    }
+
+    std::vector<BookView> MappedCatalog::findBooksByAuthor(std::string_view author, int limit) const {
+        std::vector<BookView> books;
+        if (!header || limit == 0) return books;
+        const uint32_t* first = reinterpret_cast<const uint32_t*>(base + header->authorsOffset);
+        const uint32_t* last = first + header->bookCount;
+        auto authorOf = [&](uint32_t ordinal) {
+            return text(reinterpret_cast<const BookRecord*>(base + header->recordsOffset)[ordinal].author);
+        };
+        const uint32_t* it = std::lower_bound(first, last, author,
+                                              [&](uint32_t ordinal, std::string_view value) { return authorOf(ordinal) < value; });
+        for (; it != last && authorOf(*it) == author; ++it) {
+            books.push_back(bookAt(*it));
+            if (limit > 0 && books.size() == static_cast<size_t>(limit)) break;
+        }
+        return books;
+    }
+
+    std::vector<BookView> MappedCatalog::findBooksByTag(std::string_view tag, int limit) const {
+        std::vector<BookView> books;
+        if (!header || limit == 0) return books;
+        const TagEntry* first = reinterpret_cast<const TagEntry*>(base + header->tagsOffset);
+        const TagEntry* last = first + header->tagCount;
+        const TagEntry* entry = std::lower_bound(first, last, tag,
+                                                 [&](const TagEntry& e, std::string_view value) { return text(e.name) < value; });
+        if (entry == last || text(entry->name) != tag) return books;
+        const uint32_t* postings = reinterpret_cast<const uint32_t*>(base + header->postingsOffset) + entry->postingsBegin;
+        size_t count = entry->postingsCount;
+        if (limit > 0) count = std::min(count, static_cast<size_t>(limit));
+        books.reserve(count);
+        for (size_t i = 0; i < count; ++i) books.push_back(bookAt(postings[i]));
+        return books;
+    }
+}
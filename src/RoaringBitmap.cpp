@@ -0,0 +1,509 @@
+#include "../include/lms/RoaringBitmap.h"
+#include "../include/lms/Cpu.h"
+#include <algorithm>
+#include <iterator>
+
+namespace lms {
+    namespace {
+        constexpr size_t kWords = 65536 / 64;
+
+        enum class Op { And, Or, AndNot };
+
+        inline uint32_t popcount(uint64_t x) {
+#if defined(_MSC_VER)
+            x = x - ((x >> 1) & 0x5555555555555555ULL);
+            x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+            x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+            return static_cast<uint32_t>((x * 0x0101010101010101ULL) >> 56);
+#else
+            return static_cast<uint32_t>(__builtin_popcountll(x));
+#endif
+        }
+
+        // out = a op b over one bitmap container; returns the number of bits set
+        using CombineFn = uint32_t (*)(const uint64_t* a, const uint64_t* b, uint64_t* out);
+        // out = a AND b or a AND NOT b over two sorted arrays; returns the size of
+        // out, which needs room for na + 8 values
+        using MergeFn = size_t (*)(const uint16_t* a, size_t na, const uint16_t* b, size_t nb, uint16_t* out);
+
+        template <Op op>
+        uint32_t combinePortable(const uint64_t* a, const uint64_t* b, uint64_t* out) {
+            uint32_t count = 0;
+            for (size_t i = 0; i < kWords; ++i) {
+                out[i] = op == Op::And ? a[i] & b[i] : op == Op::Or ? a[i] | b[i] : a[i] & ~b[i];
+                count += popcount(out[i]);
+            }
+            return count;
+        }
+
+        // The merges below have no data-dependent branches, which matters more than
+        // the comparison count on arrays this short
+        size_t intersectPortable(const uint16_t* a, size_t na, const uint16_t* b, size_t nb, uint16_t* out) {
+            size_t i = 0, j = 0, k = 0;
+            while (i < na && j < nb) {
+                uint16_t x = a[i], y = b[j];
+                out[k] = x;
+                k += x == y;
+                i += x <= y;
+                j += y <= x;
+            }
+            return k;
+        }
+
+        size_t subtractPortable(const uint16_t* a, size_t na, const uint16_t* b, size_t nb, uint16_t* out) {
+            size_t i = 0, j = 0, k = 0;
+            while (i < na && j < nb) {
+                uint16_t x = a[i], y = b[j];
+                out[k] = x;
+                k += x < y;
+                i += x <= y;
+                j += y <= x;
+            }
+            while (i < na) out[k++] = a[i++];
+            return k;
+        }
+
+#if LMS_X86 && (defined(__x86_64__) || defined(_M_X64))
+#define LMS_ROARING_AVX2 1
+        // Four words per instruction; counting runs on the scalar popcnt unit, which
+        // keeps up with the loads and stores
+        template <Op op>
+        LMS_TARGET("avx2,popcnt")
+        uint32_t combineAvx2(const uint64_t* a, const uint64_t* b, uint64_t* out) {
+            uint64_t count = 0;
+            for (size_t i = 0; i < kWords; i += 4) {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+                __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+                __m256i result = op == Op::And ? _mm256_and_si256(x, y)
+                               : op == Op::Or ? _mm256_or_si256(x, y)
+                               : _mm256_andnot_si256(y, x);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), result);
+                count += _mm_popcnt_u64(static_cast<uint64_t>(_mm256_extract_epi64(result, 0)));
+                count += _mm_popcnt_u64(static_cast<uint64_t>(_mm256_extract_epi64(result, 1)));
+                count += _mm_popcnt_u64(static_cast<uint64_t>(_mm256_extract_epi64(result, 2)));
+                count += _mm_popcnt_u64(static_cast<uint64_t>(_mm256_extract_epi64(result, 3)));
+            }
+            return static_cast<uint32_t>(count);
+        }
+
+        // shuffleTable()[mask] moves the 16-bit lanes selected by mask to the front
+        struct ShuffleTable {
+            alignas(16) uint8_t lanes[256][16];
+            ShuffleTable() {
+                for (int mask = 0; mask < 256; ++mask) {
+                    int out = 0;
+                    for (int lane = 0; lane < 8; ++lane) {
+                        if (!(mask & (1 << lane))) continue;
+                        lanes[mask][out++] = static_cast<uint8_t>(2 * lane);
+                        lanes[mask][out++] = static_cast<uint8_t>(2 * lane + 1);
+                    }
+                    while (out < 16) lanes[mask][out++] = 0x80;
+                }
+            }
+        };
+
+        const ShuffleTable& shuffleTable() {
+            static const ShuffleTable instance;
+            return instance;
+        }
+
+        // Bit l set if lane l of a equals any lane of b: a is compared with all eight
+        // rotations of b
+        LMS_TARGET("avx2")
+        inline int matchLanes(__m128i a, __m128i b) {
+            __m128i hits = _mm_cmpeq_epi16(a, b);
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi16(a, _mm_alignr_epi8(b, b, 2)));
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi16(a, _mm_alignr_epi8(b, b, 4)));
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi16(a, _mm_alignr_epi8(b, b, 6)));
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi16(a, _mm_alignr_epi8(b, b, 8)));
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi16(a, _mm_alignr_epi8(b, b, 10)));
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi16(a, _mm_alignr_epi8(b, b, 12)));
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi16(a, _mm_alignr_epi8(b, b, 14)));
+            return _mm_movemask_epi8(_mm_packs_epi16(hits, _mm_setzero_si128()));
+        }
+
+        LMS_TARGET("avx2")
+        inline size_t storeLanes(const ShuffleTable& table, __m128i values, int mask, uint16_t* out) {
+            __m128i shuffle = _mm_load_si128(reinterpret_cast<const __m128i*>(table.lanes[mask]));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(values, shuffle));
+            return static_cast<size_t>(_mm_popcnt_u32(static_cast<unsigned>(mask)));
+        }
+
+        // Blocks of eight: every block of a meets every block of b it overlaps, and
+        // the block with the smaller maximum moves on (the other may still match)
+        LMS_TARGET("avx2,popcnt")
+        size_t intersectAvx2(const uint16_t* a, size_t na, const uint16_t* b, size_t nb, uint16_t* out) {
+            const ShuffleTable& table = shuffleTable();
+            size_t i = 0, j = 0, k = 0;
+            while (i + 8 <= na && j + 8 <= nb) {
+                __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+                __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + j));
+                k += storeLanes(table, va, matchLanes(va, vb), out + k);
+                uint16_t lastA = a[i + 7], lastB = b[j + 7];
+                i += lastA <= lastB ? 8 : 0;
+                j += lastB <= lastA ? 8 : 0;
+            }
+            // Values of a already written matched blocks of b before j, so they cannot
+            // match again
+            return k + intersectPortable(a + i, na - i, b + j, nb - j, out + k);
+        }
+
+        // Like intersectAvx2, but a block of a is only written out (its unmatched
+        // lanes) once no later block of b can match it
+        LMS_TARGET("avx2,popcnt")
+        size_t subtractAvx2(const uint16_t* a, size_t na, const uint16_t* b, size_t nb, uint16_t* out) {
+            const ShuffleTable& table = shuffleTable();
+            size_t i = 0, j = 0, k = 0;
+            int matched = 0;
+            while (i + 8 <= na && j + 8 <= nb) {
+                __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+                __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + j));
+                matched |= matchLanes(va, vb);
+                uint16_t lastA = a[i + 7], lastB = b[j + 7];
+                if (lastA <= lastB) {
+                    k += storeLanes(table, va, ~matched & 0xFF, out + k);
+                    i += 8;
+                    matched = 0;
+                }
+                if (lastB <= lastA) j += 8;
+            }
+            // The current block of a may already have matched earlier blocks of b
+            for (size_t block = i; i < na; ++i) {
+                bool seen = i - block < 8 && (matched >> (i - block)) & 1;
+                while (j < nb && b[j] < a[i]) ++j;
+                if (!seen && (j == nb || b[j] != a[i])) out[k++] = a[i];
+            }
+            return k;
+        }
+#endif
+
+        bool simdSupported() {
+#ifdef LMS_ROARING_AVX2
+            return cpu::hasAvx2() && cpu::hasPopcnt();
+#else
+            return false;
+#endif
+        }
+
+        struct Kernels {
+            CombineFn intersect = combinePortable<Op::And>;
+            CombineFn unite = combinePortable<Op::Or>;
+            CombineFn subtract = combinePortable<Op::AndNot>;
+            MergeFn intersectArrays = intersectPortable;
+            MergeFn subtractArrays = subtractPortable;
+            bool simd = false;
+
+            Kernels() { select(simdSupported()); }
+
+            // Caller checked simdSupported() before asking for SIMD
+            void select(bool useSimd) {
+                simd = useSimd;
+                intersect = combinePortable<Op::And>;
+                unite = combinePortable<Op::Or>;
+                subtract = combinePortable<Op::AndNot>;
+                intersectArrays = intersectPortable;
+                subtractArrays = subtractPortable;
+#ifdef LMS_ROARING_AVX2
+                if (useSimd) {
+                    intersect = combineAvx2<Op::And>;
+                    unite = combineAvx2<Op::Or>;
+                    subtract = combineAvx2<Op::AndNot>;
+                    intersectArrays = intersectAvx2;
+                    subtractArrays = subtractAvx2;
+                }
+#endif
+            }
+        };
+
+        Kernels& kernels() {
+            static Kernels instance;
+            return instance;
+        }
+
+        inline bool testBit(const std::vector<uint64_t>& bits, uint16_t low) {
+            return (bits[low >> 6] >> (low & 63)) & 1;
+        }
+
+        // Intersection of two sorted arrays; when one is much smaller, each of its
+        // values is found by galloping through the larger one instead of merging
+        void intersectArrays(const std::vector<uint16_t>& a, const std::vector<uint16_t>& b, std::vector<uint16_t>& out) {
+            const std::vector<uint16_t>& small = a.size() <= b.size() ? a : b;
+            const std::vector<uint16_t>& large = a.size() <= b.size() ? b : a;
+            if (small.size() * 64 >= large.size()) {
+                out.resize(a.size() + 8);
+                out.resize(kernels().intersectArrays(a.data(), a.size(), b.data(), b.size(), out.data()));
+                return;
+            }
+            auto from = large.begin();
+            for (uint16_t value : small) {
+                size_t step = 1;
+                auto to = from;
+                while (to != large.end() && *to < value) {
+                    from = to;
+                    to = static_cast<size_t>(large.end() - to) > step ? to + step : large.end();
+                    step *= 2;
+                }
+                from = std::lower_bound(from, to, value);
+                if (from == large.end()) return;
+                if (*from == value) out.push_back(value);
+            }
+        }
+    }
+
+    bool RoaringBitmap::Container::contains(uint16_t low) const {
+        return isBitmap() ? testBit(bits, low) : std::binary_search(values.begin(), values.end(), low);
+    }
+
+    void RoaringBitmap::Container::normalize() {
+        if (isBitmap() && count <= kMaxArraySize) {
+            values.clear();
+            values.reserve(count);
+            for (size_t word = 0; word < kWords; ++word)
+                for (uint64_t set = bits[word]; set; set &= set - 1)
+                    values.push_back(static_cast<uint16_t>(word * 64 + countTrailingZeros(set)));
+            std::vector<uint64_t>().swap(bits);
+        } else if (!isBitmap() && count > kMaxArraySize) {
+            bits.assign(kWords, 0);
+            for (uint16_t low : values) bits[low >> 6] |= uint64_t(1) << (low & 63);
+            std::vector<uint16_t>().swap(values);
+        }
+    }
+
+    size_t RoaringBitmap::lowerBound(uint16_t key) const {
+        return std::lower_bound(containers.begin(), containers.end(), key,
+                                [](const Container& c, uint16_t k) { return c.key < k; }) - containers.begin();
+    }
+
+    void RoaringBitmap::add(uint32_t value) {
+        uint16_t key = static_cast<uint16_t>(value >> 16), low = static_cast<uint16_t>(value);
+        size_t i = lowerBound(key);
+        if (i == containers.size() || containers[i].key != key) {
+            containers.insert(containers.begin() + i, Container());
+            containers[i].key = key;
+        }
+        Container& container = containers[i];
+        if (container.isBitmap()) {
+            uint64_t& word = container.bits[low >> 6];
+            uint64_t mask = uint64_t(1) << (low & 63);
+            if (!(word & mask)) {
+                word |= mask;
+                ++container.count;
+            }
+            return;
+        }
+        // Ordinals usually arrive in ascending order, which appends
+        if (container.values.empty() || container.values.back() < low) {
+            container.values.push_back(low);
+        } else {
+            auto it = std::lower_bound(container.values.begin(), container.values.end(), low);
+            if (*it == low) return;
+            container.values.insert(it, low);
+        }
+        ++container.count;
+        container.normalize();
+    }
+
+    bool RoaringBitmap::remove(uint32_t value) {
+        uint16_t key = static_cast<uint16_t>(value >> 16), low = static_cast<uint16_t>(value);
+        size_t i = lowerBound(key);
+        if (i == containers.size() || containers[i].key != key) return false;
+        Container& container = containers[i];
+        if (container.isBitmap()) {
+            uint64_t& word = container.bits[low >> 6];
+            uint64_t mask = uint64_t(1) << (low & 63);
+            if (!(word & mask)) return false;
+            word &= ~mask;
+        } else {
+            auto it = std::lower_bound(container.values.begin(), container.values.end(), low);
+            if (it == container.values.end() || *it != low) return false;
+            container.values.erase(it);
+        }
+        if (--container.count == 0) containers.erase(containers.begin() + i);
+        else container.normalize();
+        return true;
+    }
+
+    bool RoaringBitmap::contains(uint32_t value) const {
+        uint16_t key = static_cast<uint16_t>(value >> 16);
+        size_t i = lowerBound(key);
+        return i < containers.size() && containers[i].key == key && containers[i].contains(static_cast<uint16_t>(value));
+    }
+
+    uint64_t RoaringBitmap::cardinality() const {
+        uint64_t total = 0;
+        for (const auto& container : containers) total += container.count;
+        return total;
+    }
+
+    size_t RoaringBitmap::memoryUsage() const {
+        size_t total = sizeof(*this) + containers.capacity() * sizeof(Container);
+        for (const auto& container : containers)
+            total += container.values.capacity() * sizeof(uint16_t) + container.bits.capacity() * sizeof(uint64_t);
+        return total;
+    }
+
+    std::vector<uint32_t> RoaringBitmap::toVector() const {
+        std::vector<uint32_t> result;
+        result.reserve(static_cast<size_t>(cardinality()));
+        forEach([&](uint32_t value) {
+            result.push_back(value);
+            return true;
+        });
+        return result;
+    }
+
+    bool RoaringBitmap::useSimd(bool enabled) {
+        if (enabled && !simdSupported()) return false;
+        kernels().select(enabled);
+        return true;
+    }
+
+    bool RoaringBitmap::usingSimd() {
+        return kernels().simd;
+    }
+
+    RoaringBitmap::Container RoaringBitmap::intersect(const Container& a, const Container& b) {
+        Container out;
+        out.key = a.key;
+        if (a.isBitmap() && b.isBitmap()) {
+            out.bits.resize(kWords);
+            out.count = kernels().intersect(a.bits.data(), b.bits.data(), out.bits.data());
+        } else if (a.isBitmap() || b.isBitmap()) {
+            const Container& array = a.isBitmap() ? b : a;
+            const Container& bitmap = a.isBitmap() ? a : b;
+            for (uint16_t low : array.values)
+                if (testBit(bitmap.bits, low)) out.values.push_back(low);
+            out.count = static_cast<uint32_t>(out.values.size());
+        } else {
+            intersectArrays(a.values, b.values, out.values);
+            out.count = static_cast<uint32_t>(out.values.size());
+        }
+        out.normalize();
+        return out;
+    }
+
+    RoaringBitmap::Container RoaringBitmap::unite(const Container& a, const Container& b) {
+        Container out;
+        out.key = a.key;
+        if (a.isBitmap() && b.isBitmap()) {
+            out.bits.resize(kWords);
+            out.count = kernels().unite(a.bits.data(), b.bits.data(), out.bits.data());
+        } else if (a.isBitmap() || b.isBitmap()) {
+            const Container& array = a.isBitmap() ? b : a;
+            const Container& bitmap = a.isBitmap() ? a : b;
+            out.bits = bitmap.bits;
+            out.count = bitmap.count;
+            for (uint16_t low : array.values) {
+                uint64_t& word = out.bits[low >> 6];
+                uint64_t mask = uint64_t(1) << (low & 63);
+                out.count += !(word & mask);
+                word |= mask;
+            }
+        } else if (a.values.size() + b.values.size() > kMaxArraySize) {
+            // Likely too many for an array: setting bits has no dependency between
+            // values, unlike a merge
+            out.bits.assign(kWords, 0);
+            for (uint16_t low : a.values) out.bits[low >> 6] |= uint64_t(1) << (low & 63);
+            out.count = a.count;
+            for (uint16_t low : b.values) {
+                uint64_t& word = out.bits[low >> 6];
+                uint64_t mask = uint64_t(1) << (low & 63);
+                out.count += !(word & mask);
+                word |= mask;
+            }
+            out.normalize();
+        } else {
+            out.values.reserve(a.values.size() + b.values.size());
+            std::set_union(a.values.begin(), a.values.end(), b.values.begin(), b.values.end(), std::back_inserter(out.values));
+            out.count = static_cast<uint32_t>(out.values.size());
+        }
+        return out;
+    }
+
+    RoaringBitmap::Container RoaringBitmap::subtract(const Container& a, const Container& b) {
+        Container out;
+        out.key = a.key;
+        if (a.isBitmap() && b.isBitmap()) {
+            out.bits.resize(kWords);
+            out.count = kernels().subtract(a.bits.data(), b.bits.data(), out.bits.data());
+        } else if (a.isBitmap()) {
+            out.bits = a.bits;
+            out.count = a.count;
+            for (uint16_t low : b.values) {
+                uint64_t& word = out.bits[low >> 6];
+                uint64_t mask = uint64_t(1) << (low & 63);
+                out.count -= (word & mask) != 0;
+                word &= ~mask;
+            }
+        } else if (b.isBitmap()) {
+            for (uint16_t low : a.values)
+                if (!testBit(b.bits, low)) out.values.push_back(low);
+            out.count = static_cast<uint32_t>(out.values.size());
+        } else {
+            out.values.resize(a.values.size() + 8);
+            out.values.resize(kernels().subtractArrays(a.values.data(), a.values.size(), b.values.data(),
+                                                       b.values.size(), out.values.data()));
+            out.count = static_cast<uint32_t>(out.values.size());
+        }
+        out.normalize();
+        return out;
+    }
+
+    RoaringBitmap operator&(const RoaringBitmap& a, const RoaringBitmap& b) {
+        RoaringBitmap result;
+        size_t i = 0, j = 0;
+        while (i < a.containers.size() && j < b.containers.size()) {
+            if (a.containers[i].key < b.containers[j].key) {
+                ++i;
+            } else if (b.containers[j].key < a.containers[i].key) {
+                ++j;
+            } else {
+                auto both = RoaringBitmap::intersect(a.containers[i++], b.containers[j++]);
+                if (both.count) result.containers.push_back(std::move(both));
+            }
+        }
+        return result;
+    }
+
+    RoaringBitmap operator|(const RoaringBitmap& a, const RoaringBitmap& b) {
+        RoaringBitmap result;
+        result.containers.reserve(a.containers.size() + b.containers.size());
+        size_t i = 0, j = 0;
+        while (i < a.containers.size() || j < b.containers.size()) {
+            if (j == b.containers.size() || (i < a.containers.size() && a.containers[i].key < b.containers[j].key))
+                result.containers.push_back(a.containers[i++]);
+            else if (i == a.containers.size() || b.containers[j].key < a.containers[i].key)
+                result.containers.push_back(b.containers[j++]);
+            else
+                result.containers.push_back(RoaringBitmap::unite(a.containers[i++], b.containers[j++]));
+        }
+        return result;
+    }
+
+    RoaringBitmap operator-(const RoaringBitmap& a, const RoaringBitmap& b) {
+        RoaringBitmap result;
+        result.containers.reserve(a.containers.size());
+        size_t j = 0;
+        for (const auto& container : a.containers) {
+            while (j < b.containers.size() && b.containers[j].key < container.key) ++j;
+            if (j == b.containers.size() || b.containers[j].key != container.key) {
+                result.containers.push_back(container);
+                continue;
+            }
+            auto rest = RoaringBitmap::subtract(container, b.containers[j]);
+            if (rest.count) result.containers.push_back(std::move(rest));
+        }
+        return result;
+    }
+
+    bool operator==(const RoaringBitmap& a, const RoaringBitmap& b) {
+        if (a.containers.size() != b.containers.size()) return false;
+        // Containers are always normalized, so equal sets have equal representations
+        for (size_t i = 0; i < a.containers.size(); ++i) {
+            const auto& x = a.containers[i];
+            const auto& y = b.containers[i];
+            if (x.key != y.key || x.count != y.count || x.values != y.values || x.bits != y.bits) return false;
+        }
+        return true;
+    }
+}
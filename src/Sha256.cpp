@@ -0,0 +1,359 @@
+#include "../include/lms/Sha256.h"
+#include "../include/lms/Cpu.h"
+#include <algorithm>
+#include <cstring>
+
+namespace lms {
+    namespace sha256 {
+        namespace {
+            const uint32_t kInitialState[8] = {
+                0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+            alignas(16) const uint32_t kRound[64] = {
+                0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+                0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+                0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+                0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+                0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+                0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+                0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+                0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+            // Longest message (in padded blocks) the multi-buffer path takes; longer
+            // ones are hashed one at a time. Two blocks cover inputs up to 119 bytes.
+            constexpr size_t kBatchBlocks = 2;
+            constexpr size_t kLanes = 8;
+
+            // Two hex digits per byte value
+            struct HexTable {
+                char pairs[512];
+                constexpr HexTable() : pairs() {
+                    const char digits[] = "0123456789abcdef";
+                    for (int i = 0; i < 256; ++i) {
+                        pairs[2 * i] = digits[i >> 4];
+                        pairs[2 * i + 1] = digits[i & 0xF];
+                    }
+                }
+            };
+            constexpr HexTable kHex;
+
+            inline uint32_t loadBigEndian(const uint8_t* p) {
+                return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | uint32_t(p[3]);
+            }
+
+            inline void storeBigEndian(uint8_t* p, uint32_t value) {
+                p[0] = uint8_t(value >> 24);
+                p[1] = uint8_t(value >> 16);
+                p[2] = uint8_t(value >> 8);
+                p[3] = uint8_t(value);
+            }
+
+            inline uint32_t rotr(uint32_t x, int n) {
+                return (x >> n) | (x << (32 - n));
+            }
+
+            // Appends the 0x80 marker and the bit length to the last partial block of
+            // data; returns how many blocks (1 or 2) of tail to compress
+            size_t padTail(std::string_view data, uint8_t tail[128]) {
+                size_t rest = data.size() % 64;
+                std::memset(tail, 0, 128);
+                std::memcpy(tail, data.data() + data.size() - rest, rest);
+                tail[rest] = 0x80;
+                size_t blocks = rest < 56 ? 1 : 2;
+                uint64_t bits = uint64_t(data.size()) * 8;
+                for (int i = 0; i < 8; ++i) tail[blocks * 64 - 1 - i] = uint8_t(bits >> (8 * i));
+                return blocks;
+            }
+
+            using CompressFn = void (*)(uint32_t* state, const uint8_t* blocks, size_t count);
+
+            void compressPortable(uint32_t* state, const uint8_t* blocks, size_t count) {
+                uint32_t w[64];
+                for (; count; --count, blocks += 64) {
+                    for (int t = 0; t < 16; ++t) w[t] = loadBigEndian(blocks + 4 * t);
+                    for (int t = 16; t < 64; ++t) {
+                        uint32_t s0 = rotr(w[t - 15], 7) ^ rotr(w[t - 15], 18) ^ (w[t - 15] >> 3);
+                        uint32_t s1 = rotr(w[t - 2], 17) ^ rotr(w[t - 2], 19) ^ (w[t - 2] >> 10);
+                        w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+                    }
+                    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+                    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+                    for (int t = 0; t < 64; ++t) {
+                        uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + kRound[t] + w[t];
+                        uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+                        h = g;
+                        g = f;
+                        f = e;
+                        e = d + t1;
+                        d = c;
+                        c = b;
+                        b = a;
+                        a = t1 + t2;
+                    }
+                    state[0] += a;
+                    state[1] += b;
+                    state[2] += c;
+                    state[3] += d;
+                    state[4] += e;
+                    state[5] += f;
+                    state[6] += g;
+                    state[7] += h;
+                }
+            }
+
+            Digest hashWith(CompressFn compress, std::string_view data) {
+                uint32_t state[8];
+                std::memcpy(state, kInitialState, sizeof(state));
+                size_t full = data.size() / 64;
+                if (full) compress(state, reinterpret_cast<const uint8_t*>(data.data()), full);
+                uint8_t tail[128];
+                compress(state, tail, padTail(data, tail));
+                Digest digest;
+                for (int i = 0; i < 8; ++i) storeBigEndian(digest.data() + 4 * i, state[i]);
+                return digest;
+            }
+
+#if LMS_X86
+            // Rounds 4i..4i+3 with schedule words w
+            LMS_TARGET("sha,sse4.1")
+            inline void shaNiRounds(__m128i& state0, __m128i& state1, __m128i w, int i) {
+                __m128i message = _mm_add_epi32(w, _mm_load_si128(reinterpret_cast<const __m128i*>(kRound + 4 * i)));
+                state1 = _mm_sha256rnds2_epu32(state1, state0, message);
+                state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(message, 0x0E));
+            }
+
+            // The next four schedule words from the previous sixteen, a the oldest
+            LMS_TARGET("sha,sse4.1")
+            inline __m128i shaNiSchedule(__m128i a, __m128i b, __m128i c, __m128i d) {
+                __m128i next = _mm_add_epi32(_mm_sha256msg1_epu32(a, b), _mm_alignr_epi8(d, c, 4));
+                return _mm_sha256msg2_epu32(next, d);
+            }
+
+            // Four rounds per step: the state is kept as ABEF / CDGH, the layout
+            // sha256rnds2 works on
+            LMS_TARGET("sha,sse4.1")
+            void compressShaNi(uint32_t* state, const uint8_t* blocks, size_t count) {
+                const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+                __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0xB1);
+                __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4)), 0x1B);
+                __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+                state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+                for (; count; --count, blocks += 64) {
+                    __m128i saved0 = state0, saved1 = state1;
+                    __m128i w0 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks)), byteSwap);
+                    __m128i w1 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + 16)), byteSwap);
+                    __m128i w2 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + 32)), byteSwap);
+                    __m128i w3 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + 48)), byteSwap);
+                    shaNiRounds(state0, state1, w0, 0);
+                    shaNiRounds(state0, state1, w1, 1);
+                    shaNiRounds(state0, state1, w2, 2);
+                    shaNiRounds(state0, state1, w3, 3);
+                    for (int i = 4; i < 16; i += 4) {
+                        w0 = shaNiSchedule(w0, w1, w2, w3);
+                        shaNiRounds(state0, state1, w0, i);
+                        w1 = shaNiSchedule(w1, w2, w3, w0);
+                        shaNiRounds(state0, state1, w1, i + 1);
+                        w2 = shaNiSchedule(w2, w3, w0, w1);
+                        shaNiRounds(state0, state1, w2, i + 2);
+                        w3 = shaNiSchedule(w3, w0, w1, w2);
+                        shaNiRounds(state0, state1, w3, i + 3);
+                    }
+                    state0 = _mm_add_epi32(state0, saved0);
+                    state1 = _mm_add_epi32(state1, saved1);
+                }
+
+                tmp = _mm_shuffle_epi32(state0, 0x1B);
+                state1 = _mm_shuffle_epi32(state1, 0xB1);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_blend_epi16(tmp, state1, 0xF0));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), _mm_alignr_epi8(state1, tmp, 8));
+            }
+
+            template <int N>
+            LMS_TARGET("avx2")
+            inline __m256i rotr8(__m256i x) {
+                return _mm256_or_si256(_mm256_srli_epi32(x, N), _mm256_slli_epi32(x, 32 - N));
+            }
+
+            // One block of eight independent messages, one per 32-bit lane. Lanes
+            // outside active keep their state.
+            LMS_TARGET("avx2")
+            void compressAvx2(__m256i* state, const uint8_t* const* lanes, __m256i active) {
+                __m256i w[16];
+                for (int t = 0; t < 16; ++t)
+                    w[t] = _mm256_setr_epi32(
+                        static_cast<int>(loadBigEndian(lanes[0] + 4 * t)), static_cast<int>(loadBigEndian(lanes[1] + 4 * t)),
+                        static_cast<int>(loadBigEndian(lanes[2] + 4 * t)), static_cast<int>(loadBigEndian(lanes[3] + 4 * t)),
+                        static_cast<int>(loadBigEndian(lanes[4] + 4 * t)), static_cast<int>(loadBigEndian(lanes[5] + 4 * t)),
+                        static_cast<int>(loadBigEndian(lanes[6] + 4 * t)), static_cast<int>(loadBigEndian(lanes[7] + 4 * t)));
+                __m256i a = state[0], b = state[1], c = state[2], d = state[3];
+                __m256i e = state[4], f = state[5], g = state[6], h = state[7];
+                for (int t = 0; t < 64; ++t) {
+                    if (t >= 16) {
+                        __m256i w15 = w[(t - 15) & 15], w2 = w[(t - 2) & 15];
+                        __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(rotr8<7>(w15), rotr8<18>(w15)), _mm256_srli_epi32(w15, 3));
+                        __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(rotr8<17>(w2), rotr8<19>(w2)), _mm256_srli_epi32(w2, 10));
+                        w[t & 15] = _mm256_add_epi32(_mm256_add_epi32(w[t & 15], s0), _mm256_add_epi32(w[(t - 7) & 15], s1));
+                    }
+                    __m256i sigma1 = _mm256_xor_si256(_mm256_xor_si256(rotr8<6>(e), rotr8<11>(e)), rotr8<25>(e));
+                    __m256i choose = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+                    __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, sigma1), _mm256_add_epi32(choose, w[t & 15]));
+                    t1 = _mm256_add_epi32(t1, _mm256_set1_epi32(static_cast<int>(kRound[t])));
+                    __m256i sigma0 = _mm256_xor_si256(_mm256_xor_si256(rotr8<2>(a), rotr8<13>(a)), rotr8<22>(a));
+                    __m256i majority = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+                    __m256i t2 = _mm256_add_epi32(sigma0, majority);
+                    h = g;
+                    g = f;
+                    f = e;
+                    e = _mm256_add_epi32(d, t1);
+                    d = c;
+                    c = b;
+                    b = a;
+                    a = _mm256_add_epi32(t1, t2);
+                }
+                const __m256i result[8] = {a, b, c, d, e, f, g, h};
+                for (int i = 0; i < 8; ++i)
+                    state[i] = _mm256_blendv_epi8(state[i], _mm256_add_epi32(state[i], result[i]), active);
+            }
+
+            // Hashes up to kLanes messages of at most kBatchBlocks padded blocks
+            LMS_TARGET("avx2")
+            void hashLanesAvx2(const std::string_view* inputs, size_t count, Digest* out) {
+                alignas(32) uint8_t padded[kLanes][kBatchBlocks * 64];
+                const uint8_t* lanes[kLanes];
+                int blocks[kLanes] = {};
+                int maxBlocks = 0;
+                for (size_t lane = 0; lane < kLanes; ++lane) {
+                    std::string_view data = lane < count ? inputs[lane] : std::string_view();
+                    size_t full = data.size() / 64;
+                    std::memcpy(padded[lane], data.data(), full * 64);
+                    uint8_t tail[128];
+                    size_t tailBlocks = padTail(data, tail);
+                    std::memcpy(padded[lane] + full * 64, tail, tailBlocks * 64);
+                    blocks[lane] = lane < count ? static_cast<int>(full + tailBlocks) : 0;
+                    maxBlocks = std::max(maxBlocks, blocks[lane]);
+                }
+                __m256i state[8];
+                for (int i = 0; i < 8; ++i) state[i] = _mm256_set1_epi32(static_cast<int>(kInitialState[i]));
+                __m256i laneBlocks = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks));
+                for (int block = 0; block < maxBlocks; ++block) {
+                    for (size_t lane = 0; lane < kLanes; ++lane) lanes[lane] = padded[lane] + 64 * (block < blocks[lane] ? block : 0);
+                    compressAvx2(state, lanes, _mm256_cmpgt_epi32(laneBlocks, _mm256_set1_epi32(block)));
+                }
+                alignas(32) uint32_t words[8][kLanes];
+                for (int i = 0; i < 8; ++i) _mm256_store_si256(reinterpret_cast<__m256i*>(words[i]), state[i]);
+                for (size_t lane = 0; lane < count; ++lane)
+                    for (int i = 0; i < 8; ++i) storeBigEndian(out[lane].data() + 4 * i, words[i][lane]);
+            }
+#endif
+
+            struct Dispatch {
+                Backend single = Backend::Portable;
+                Backend batch = Backend::Portable;
+                CompressFn compress = compressPortable;
+
+                Dispatch() {
+#if LMS_X86
+                    if (cpu::hasShaNi()) {
+                        single = batch = Backend::ShaNi;
+                        compress = compressShaNi;
+                    } else if (cpu::hasAvx2()) {
+                        batch = Backend::Avx2;
+                    }
+#endif
+                }
+            };
+
+            Dispatch& dispatch() {
+                static Dispatch instance;
+                return instance;
+            }
+
+            bool supported(Backend backend) {
+#if LMS_X86
+                if (backend == Backend::ShaNi) return cpu::hasShaNi();
+                if (backend == Backend::Avx2) return cpu::hasAvx2();
+#endif
+                return backend == Backend::Portable;
+            }
+
+            CompressFn compressFor(Backend backend) {
+#if LMS_X86
+                if (backend == Backend::ShaNi) return compressShaNi;
+#endif
+                return compressPortable;
+            }
+        }
+
+        Digest hash(std::string_view data) {
+            return hashWith(dispatch().compress, data);
+        }
+
+        void hashMany(const std::string_view* inputs, size_t count, Digest* out) {
+            const Dispatch& d = dispatch();
+#if LMS_X86
+            if (d.batch == Backend::Avx2) {
+                // Gather short messages into groups of eight; long ones go one by one
+                size_t group[kLanes];
+                std::string_view groupInputs[kLanes];
+                Digest groupOut[kLanes];
+                size_t filled = 0;
+                auto flush = [&] {
+                    hashLanesAvx2(groupInputs, filled, groupOut);
+                    for (size_t i = 0; i < filled; ++i) out[group[i]] = groupOut[i];
+                    filled = 0;
+                };
+                for (size_t i = 0; i < count; ++i) {
+                    if (inputs[i].size() + 9 > kBatchBlocks * 64) {
+                        out[i] = hashWith(d.compress, inputs[i]);
+                        continue;
+                    }
+                    group[filled] = i;
+                    groupInputs[filled++] = inputs[i];
+                    if (filled == kLanes) flush();
+                }
+                if (filled) flush();
+                return;
+            }
+#endif
+            CompressFn compress = compressFor(d.batch);
+            for (size_t i = 0; i < count; ++i) out[i] = hashWith(compress, inputs[i]);
+        }
+
+        void toHex(const uint8_t* bytes, size_t size, char* out) {
+            for (size_t i = 0; i < size; ++i) std::memcpy(out + 2 * i, kHex.pairs + 2 * bytes[i], 2);
+        }
+
+        std::string toHex(const uint8_t* bytes, size_t size) {
+            std::string text(2 * size, '\0');
+            toHex(bytes, size, &text[0]);
+            return text;
+        }
+
+        Backend singleBackend() {
+            return dispatch().single;
+        }
+
+        Backend batchBackend() {
+            return dispatch().batch;
+        }
+
+        const char* backendName(Backend backend) {
+            switch (backend) {
+                case Backend::ShaNi: return "sha-ni";
+                case Backend::Avx2: return "avx2";
+                default: return "portable";
+            }
+        }
+
+        bool useBackends(Backend single, Backend batch) {
+            // The AVX2 path only exists for batches
+            if (single == Backend::Avx2 || !supported(single) || !supported(batch)) return false;
+            Dispatch& d = dispatch();
+            d.single = single;
+            d.batch = batch;
+            d.compress = compressFor(single);
+            return true;
+        }
+    }
+}
@@ -0,0 +1,72 @@
+#include "../include/lms/StringPool.h"
+#include <cstring>
+#include <mutex>
+
+namespace lms {
+    StringPool::StringPool() {
+        strings.emplace_back();
+        index.emplace(std::string_view(), kEmpty);
+    }
+
+    StringPool::Handle StringPool::intern(std::string_view text) {
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            auto it = index.find(text);
+            if (it != index.end()) return it->second;
+        }
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        // Another thread may have added it between the two locks
+        auto it = index.find(text);
+        if (it != index.end()) return it->second;
+        std::string_view stored(store(text), text.size());
+        Handle handle = static_cast<Handle>(strings.size());
+        strings.push_back(stored);
+        index.emplace(stored, handle);
+        return handle;
+    }
+
+    bool StringPool::find(std::string_view text, Handle& out) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto it = index.find(text);
+        if (it == index.end()) return false;
+        out = it->second;
+        return true;
+    }
+
+    std::string_view StringPool::view(Handle handle) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return handle < strings.size() ? strings[handle] : std::string_view();
+    }
+
+    size_t StringPool::size() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return strings.size();
+    }
+
+    size_t StringPool::memoryUsage() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        // Approximate the hash table as one node per entry plus the bucket array
+        return chunkBytes + strings.capacity() * sizeof(std::string_view) +
+               index.size() * (sizeof(std::string_view) + sizeof(Handle) + 2 * sizeof(void*)) +
+               index.bucket_count() * sizeof(void*);
+    }
+
+    const char* StringPool::store(std::string_view text) {
+        // Long strings get a block of their own so they do not waste the current chunk
+        if (text.size() > kChunkSize / 4) {
+            large.push_back(std::make_unique<char[]>(text.size()));
+            chunkBytes += text.size();
+            std::memcpy(large.back().get(), text.data(), text.size());
+            return large.back().get();
+        }
+        if (chunkUsed + text.size() > kChunkSize) {
+            chunks.push_back(std::make_unique<char[]>(kChunkSize));
+            chunkBytes += kChunkSize;
+            chunkUsed = 0;
+        }
+        char* destination = chunks.back().get() + chunkUsed;
+        std::memcpy(destination, text.data(), text.size());
+        chunkUsed += text.size();
+        return destination;
+    }
+}
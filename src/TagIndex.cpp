@@ -0,0 +1,375 @@
+#include "../include/lms/TagIndex.h"
+#include "../include/lms/Book.h"
+#include <algorithm>
+#include <mutex>
+
+namespace lms {
+    struct TagQuery::Node {
+        enum class Kind { Tag, And, Or, Not };
+        Kind kind;
+        std::string tag;
+        std::unique_ptr<Node> left;     // The operand of Not
+        std::unique_ptr<Node> right;
+
+        static std::unique_ptr<Node> make(Kind kind, std::unique_ptr<Node> left, std::unique_ptr<Node> right = nullptr) {
+            auto node = std::make_unique<Node>();
+            node->kind = kind;
+            node->left = std::move(left);
+            node->right = std::move(right);
+            return node;
+        }
+    };
+
+    namespace {
+        // Fills id if text is canonical and not the all-zero ID, which ids uses to mark
+        // custom IDs; the all-zero ID itself is then kept as a custom one
+        bool parseNonNull(std::string_view text, BookId& id) {
+            return BookId::parse(text, id) && !id.isNull();
+        }
+
+        struct Token {
+            enum class Kind { Tag, And, Or, Not, Open, Close, End };
+            Kind kind;
+            std::string text;
+        };
+
+        // Recursive descent over the grammar in TagIndex.h
+        class Parser {
+        public:
+            explicit Parser(std::string_view text) : text(text) { advance(); }
+
+            std::unique_ptr<TagQuery::Node> parse(std::string& error) {
+                auto root = parseOr();
+                if (root && current.kind != Token::Kind::End) fail("unexpected ')'");
+                if (!message.empty()) {
+                    error = message;
+                    return nullptr;
+                }
+                return root;
+            }
+
+        private:
+            using Node = TagQuery::Node;
+
+            std::unique_ptr<Node> parseOr() {
+                auto left = parseAnd();
+                while (left && current.kind == Token::Kind::Or) {
+                    advance();
+                    auto right = parseAnd();
+                    if (!right) return nullptr;
+                    left = Node::make(Node::Kind::Or, std::move(left), std::move(right));
+                }
+                return left;
+            }
+
+            std::unique_ptr<Node> parseAnd() {
+                auto left = parseUnary();
+                while (left) {
+                    if (current.kind == Token::Kind::And) {
+                        advance();
+                    } else if (current.kind != Token::Kind::Not && current.kind != Token::Kind::Tag &&
+                               current.kind != Token::Kind::Open) {
+                        break;
+                    }
+                    // "a NOT b" reads as "a AND NOT b", which parseUnary produces
+                    auto right = parseUnary();
+                    if (!right) return nullptr;
+                    left = Node::make(Node::Kind::And, std::move(left), std::move(right));
+                }
+                return left;
+            }
+
+            std::unique_ptr<Node> parseUnary() {
+                switch (current.kind) {
+                    case Token::Kind::Not: {
+                        advance();
+                        auto operand = parseUnary();
+                        return operand ? Node::make(Node::Kind::Not, std::move(operand)) : nullptr;
+                    }
+                    case Token::Kind::Open: {
+                        advance();
+                        auto inner = parseOr();
+                        if (!inner) return nullptr;
+                        if (current.kind != Token::Kind::Close) return fail("missing ')'");
+                        advance();
+                        return inner;
+                    }
+                    case Token::Kind::Tag: {
+                        auto node = Node::make(Node::Kind::Tag, nullptr);
+                        node->tag = std::move(current.text);
+                        advance();
+                        return node;
+                    }
+                    case Token::Kind::End:
+                        return fail(text.empty() ? "empty query" : "query ends after an operator");
+                    default:
+                        return fail("expected a tag, NOT or '('");
+                }
+            }
+
+            std::unique_ptr<Node> fail(const char* why) {
+                if (message.empty()) message = why;
+                return nullptr;
+            }
+
+            void advance() {
+                while (position < text.size() && (text[position] == ' ' || text[position] == '\t')) ++position;
+                current.text.clear();
+                if (position == text.size()) {
+                    current.kind = Token::Kind::End;
+                    return;
+                }
+                char c = text[position];
+                if (c == '(' || c == ')') {
+                    current.kind = c == '(' ? Token::Kind::Open : Token::Kind::Close;
+                    ++position;
+                    return;
+                }
+                current.kind = Token::Kind::Tag;
+                if (c == '"') {
+                    size_t close = text.find('"', position + 1);
+                    if (close == std::string_view::npos) {
+                        fail("unterminated quote");
+                        current.kind = Token::Kind::End;
+                        position = text.size();
+                        return;
+                    }
+                    current.text.assign(text.substr(position + 1, close - position - 1));
+                    position = close + 1;
+                    return;
+                }
+                size_t end = text.find_first_of(" \t()", position);
+                if (end == std::string_view::npos) end = text.size();
+                current.text.assign(text.substr(position, end - position));
+                position = end;
+                if (current.text == "AND") current.kind = Token::Kind::And;
+                else if (current.text == "OR") current.kind = Token::Kind::Or;
+                else if (current.text == "NOT") current.kind = Token::Kind::Not;
+            }
+
+            std::string_view text;
+            size_t position = 0;
+            Token current;
+            std::string message;
+        };
+
+        bool hasTag(std::string_view tags, std::string_view tag) {
+            size_t start = 0;
+            while (start < tags.size()) {
+                size_t end = tags.find(kTagSeparator, start);
+                if (end == std::string_view::npos) end = tags.size();
+                if (tags.substr(start, end - start) == tag) return true;
+                start = end + 1;
+            }
+            return false;
+        }
+
+        bool evaluateOn(const TagQuery::Node& node, std::string_view tags) {
+            using Kind = TagQuery::Node::Kind;
+            switch (node.kind) {
+                case Kind::Tag: return hasTag(tags, node.tag);
+                case Kind::And: return evaluateOn(*node.left, tags) && evaluateOn(*node.right, tags);
+                case Kind::Or: return evaluateOn(*node.left, tags) || evaluateOn(*node.right, tags);
+                default: return !evaluateOn(*node.left, tags);
+            }
+        }
+
+        const RoaringBitmap kNoBooks;
+    }
+
+    TagQuery::TagQuery() = default;
+    TagQuery::~TagQuery() = default;
+    TagQuery::TagQuery(TagQuery&&) noexcept = default;
+    TagQuery& TagQuery::operator=(TagQuery&&) noexcept = default;
+
+    bool TagQuery::parse(std::string_view text, TagQuery& out, std::string* error) {
+        std::string message;
+        auto root = Parser(text).parse(message);
+        if (!root) {
+            if (error) *error = message;
+            return false;
+        }
+        out.root = std::move(root);
+        return true;
+    }
+
+    bool TagQuery::matches(std::string_view tags) const {
+        return root && evaluateOn(*root, tags);
+    }
+
+    void TagIndex::setBook(std::string_view bookID, std::string_view tags) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        uint32_t ordinal;
+        if (!findOrdinal(bookID, ordinal)) ordinal = addOrdinal(bookID);
+        auto& numbers = bookTags[ordinal];
+        for (uint32_t number : numbers) postings[number].remove(ordinal);
+        numbers.clear();
+        size_t start = 0;
+        while (start < tags.size()) {
+            size_t end = tags.find(kTagSeparator, start);
+            if (end == std::string_view::npos) end = tags.size();
+            std::string tag(tags.substr(start, end - start));
+            start = end + 1;
+            auto it = tagNumbers.find(tag);
+            if (it == tagNumbers.end()) {
+                it = tagNumbers.emplace(std::move(tag), static_cast<uint32_t>(postings.size())).first;
+                postings.emplace_back();
+            }
+            if (std::find(numbers.begin(), numbers.end(), it->second) != numbers.end()) continue;
+            numbers.push_back(it->second);
+            postings[it->second].add(ordinal);
+        }
+    }
+
+    void TagIndex::removeBook(std::string_view bookID) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        uint32_t ordinal;
+        if (!findOrdinal(bookID, ordinal)) return;
+        for (uint32_t number : bookTags[ordinal]) postings[number].remove(ordinal);
+        bookTags[ordinal].clear();
+        books.remove(ordinal);
+        BookId id;
+        if (parseNonNull(bookID, id)) {
+            canonicalOrdinals.erase(id);
+        } else {
+            customOrdinals.erase(std::string(bookID));
+            customIds.erase(ordinal);
+        }
+        ids[ordinal] = BookId();
+        freeOrdinals.push_back(ordinal);
+    }
+
+    void TagIndex::clear() {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        canonicalOrdinals.clear();
+        customOrdinals.clear();
+        ids.clear();
+        customIds.clear();
+        freeOrdinals.clear();
+        bookTags.clear();
+        books.clear();
+        tagNumbers.clear();
+        postings.clear();
+    }
+
+    RoaringBitmap TagIndex::match(const TagQuery& query) const {
+        if (!query.root) return RoaringBitmap();
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return evaluate(*query.root);
+    }
+
+    uint64_t TagIndex::count(const TagQuery& query) const {
+        return match(query).cardinality();
+    }
+
+    std::vector<std::string> TagIndex::findBooks(const TagQuery& query, int limit) const {
+        std::vector<std::string> result;
+        if (!query.root || limit == 0) return result;
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        RoaringBitmap matches = evaluate(*query.root);
+        result.reserve(static_cast<size_t>(matches.cardinality()));
+        matches.forEach([&](uint32_t ordinal) {
+            result.push_back(idAt(ordinal));
+            return true;
+        });
+        lock.unlock();
+        // Ordinals follow load order, not ID order, once books are added or removed
+        if (limit > 0 && static_cast<size_t>(limit) < result.size()) {
+            std::partial_sort(result.begin(), result.begin() + limit, result.end());
+            result.resize(static_cast<size_t>(limit));
+        } else {
+            std::sort(result.begin(), result.end());
+        }
+        return result;
+    }
+
+    size_t TagIndex::bookCount() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return static_cast<size_t>(books.cardinality());
+    }
+
+    size_t TagIndex::tagCount() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return tagNumbers.size();
+    }
+
+    size_t TagIndex::memoryUsage() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        size_t total = books.memoryUsage();
+        for (const auto& bitmap : postings) total += bitmap.memoryUsage();
+        return total;
+    }
+
+    RoaringBitmap TagIndex::evaluate(const TagQuery::Node& node) const {
+        using Kind = TagQuery::Node::Kind;
+        // Tag operands are combined straight from their posting lists, without a copy
+        auto operand = [&](const TagQuery::Node& child, RoaringBitmap& scratch) -> const RoaringBitmap& {
+            if (child.kind == Kind::Tag) return *postingsFor(child.tag);
+            scratch = evaluate(child);
+            return scratch;
+        };
+        RoaringBitmap leftScratch, rightScratch;
+        switch (node.kind) {
+            case Kind::Tag:
+                return *postingsFor(node.tag);
+            case Kind::Not:
+                return books - operand(*node.left, leftScratch);
+            case Kind::Or:
+                return operand(*node.left, leftScratch) | operand(*node.right, rightScratch);
+            default:
+                // a AND NOT b is a single ANDNOT, with no complement of b
+                if (node.right->kind == Kind::Not)
+                    return operand(*node.left, leftScratch) - operand(*node.right->left, rightScratch);
+                if (node.left->kind == Kind::Not)
+                    return operand(*node.right, rightScratch) - operand(*node.left->left, leftScratch);
+                return operand(*node.left, leftScratch) & operand(*node.right, rightScratch);
+        }
+    }
+
+    const RoaringBitmap* TagIndex::postingsFor(const std::string& tag) const {
+        auto it = tagNumbers.find(tag);
+        return it == tagNumbers.end() ? &kNoBooks : &postings[it->second];
+    }
+
+    bool TagIndex::findOrdinal(std::string_view bookID, uint32_t& ordinal) const {
+        BookId id;
+        if (parseNonNull(bookID, id)) {
+            auto it = canonicalOrdinals.find(id);
+            if (it == canonicalOrdinals.end()) return false;
+            ordinal = it->second;
+            return true;
+        }
+        auto it = customOrdinals.find(std::string(bookID));
+        if (it == customOrdinals.end()) return false;
+        ordinal = it->second;
+        return true;
+    }
+
+    uint32_t TagIndex::addOrdinal(std::string_view bookID) {
+        uint32_t ordinal;
+        if (!freeOrdinals.empty()) {
+            ordinal = freeOrdinals.back();
+            freeOrdinals.pop_back();
+        } else {
+            ordinal = static_cast<uint32_t>(ids.size());
+            ids.emplace_back();
+            bookTags.emplace_back();
+        }
+        BookId id;
+        if (parseNonNull(bookID, id)) {
+            canonicalOrdinals.emplace(id, ordinal);
+            ids[ordinal] = id;
+        } else {
+            customOrdinals.emplace(std::string(bookID), ordinal);
+            customIds.emplace(ordinal, std::string(bookID));
+        }
+        books.add(ordinal);
+        return ordinal;
+    }
+
+    std::string TagIndex::idAt(uint32_t ordinal) const {
+        if (!ids[ordinal].isNull()) return ids[ordinal].toHex();
+        auto it = customIds.find(ordinal);
+        return it == customIds.end() ? std::string() : it->second;
+    }
+}
@@ -1,78 +1,115 @@
 #include "../include/lms/User.h"
 #include "../include/lms/Book.h"
 #include "../include/lms/Database.h"
+#include "../include/lms/Sha256.h"
 #include <algorithm>
 
 namespace lms {
-    User::User(const std::string& name, const std::string& email, const std::string& dob, const std::string& address)
-        : name(name), email(email), dob(dob), address(address), isActive(true) {}
-
-    std::string User::getUserID() const { return userID; }
-    std::string User::getName() const { return name; } 
-    std::string User::getEmail() const { return email; }
-    std::string User::getDOB() const { return dob; }
-    std::string User::getAddress() const { return address; }
-    std::vector<std::string> User::getBorrowedBooks() const { return borrowedBooks; }
-    bool User::active() const { return isActive; }
-
-    void User::setUserID(const std::string& _userID) { userID = _userID; }
-    void User::setName(const std::string& _name) { name = _name; }
-    void User::setEmail(const std::string& _email) { email = _email; }
-    void User::setDOB(const std::string& _dob) { dob = _dob; }
-    void User::setAddress(const std::string& _address) { address = _address; }
-    void User::setBorrowedBooks(const std::vector<std::string>& books) { borrowedBooks = books; }
-    void User::setActive(bool status) { isActive = status; }
+    User::User(std::string name, std::string email, std::string dob, std::string address)
+        : name(std::move(name)), email(std::move(email)), dob(std::move(dob)), address(std::move(address)), isActive(true) {}
+
+    UserId User::getID() const { return UserId::fromHex(userID); }
+
+    std::vector<std::string> User::getBorrowedBooks() const {
+        std::vector<std::string> books;
+        books.reserve(borrowedCount());
+        for (const auto& bookID : borrowedBooks) books.push_back(bookID.toHex());
+        books.insert(books.end(), customBorrowed.begin(), customBorrowed.end());
+        return books;
+    }
+
+    void User::setUserID(std::string _userID) { userID = std::move(_userID); }
+    void User::setID(const UserId& _userID) { userID = _userID.toHex(); }
+    void User::setName(std::string _name) { name = std::move(_name); dirty |= NameField; }
+    void User::setEmail(std::string _email) { email = std::move(_email); dirty |= EmailField; }
+    void User::setDOB(std::string _dob) { dob = std::move(_dob); dirty |= DobField; }
+    void User::setAddress(std::string _address) { address = std::move(_address); dirty |= AddressField; }
+    void User::setBorrowedBooks(const std::vector<std::string>& books) {
+        borrowedBooks.clear();
+        customBorrowed.clear();
+        for (const auto& bookID : books) addBorrowedBook(bookID);
+    }
+
+    void User::setBorrowedBooks(std::vector<BookId> books, std::vector<std::string> customBooks) {
+        borrowedBooks = std::move(books);
+        customBorrowed = std::move(customBooks);
+    }
+    void User::setActive(bool status) { isActive = status; dirty |= ActiveField; }
+
+    bool User::hasBorrowed(const std::string& bookID) const {
+        BookId id;
+        if (BookId::parse(bookID, id))
+            return std::find(borrowedBooks.begin(), borrowedBooks.end(), id) != borrowedBooks.end();
+        return std::find(customBorrowed.begin(), customBorrowed.end(), bookID) != customBorrowed.end();
+    }
 
     void User::addBorrowedBook(const std::string& bookID) {
-        if (std::find(borrowedBooks.begin(), borrowedBooks.end(), bookID) == borrowedBooks.end())
-            borrowedBooks.push_back(bookID);
+        if (hasBorrowed(bookID)) return;
+        BookId id;
+        if (BookId::parse(bookID, id)) borrowedBooks.push_back(id);
+        else customBorrowed.push_back(bookID);
     }
 
     void User::removeBorrowedBook(const std::string& bookID) {
-        auto it = std::remove(borrowedBooks.begin(), borrowedBooks.end(), bookID);
-        if (it != borrowedBooks.end())
-            borrowedBooks.erase(it, borrowedBooks.end());
+        BookId id;
+        if (BookId::parse(bookID, id))
+            borrowedBooks.erase(std::remove(borrowedBooks.begin(), borrowedBooks.end(), id), borrowedBooks.end());
+        else
+            customBorrowed.erase(std::remove(customBorrowed.begin(), customBorrowed.end(), bookID), customBorrowed.end());
     }
 
     bool User::borrowBookDB(const std::string& bookID, Database& db) {
-        // Update in-memory state
-        if (std::find(borrowedBooks.begin(), borrowedBooks.end(), bookID) == borrowedBooks.end())
-            borrowedBooks.push_back(bookID);
-        else
+        if (hasBorrowed(bookID))
             return false; // Already borrowed
 
-        // Update user in DB
-        if (!db.updateUser(*this)) return false;
-
-        // Update book's currentUser in DB
-        Book book = db.getBook(bookID);
-        if (book.getBookID().empty()) return false; // Book not found
-        book.setCurrentUser(userID);
-        book.setAvailable(false);
-        return db.updateBook(book);
+        // Update DB first, then in-memory state
+        if (db.borrowBook(userID, bookID) != LoanStatus::Success) return false;
+        addBorrowedBook(bookID);
+        return true;
     }
 
     bool User::returnBookDB(const std::string& bookID, Database& db) {
-        // Update in-memory state
-        auto it = std::remove(borrowedBooks.begin(), borrowedBooks.end(), bookID);
-        if (it == borrowedBooks.end()) return false; // Not borrowed
-        borrowedBooks.erase(it, borrowedBooks.end());
-
-        // Update user in DB
-        if (!db.updateUser(*this)) return false;
-
-        // Update book's currentUser in DB
-        Book book = db.getBook(bookID);
-        if (book.getBookID().empty()) return false; // Book not found
-        book.setCurrentUser("");
-        book.setAvailable(true);
-        return db.updateBook(book);
+        if (!hasBorrowed(bookID))
+            return false; // Not borrowed
+
+        // Update DB first, then in-memory state
+        if (db.returnBook(userID, bookID) != LoanStatus::Success) return false;
+        removeBorrowedBook(bookID);
+        return true;
     }
 
     std::string User::generateID() const {
         std::string data = name + email + dob + address;
-        std::string hash = picosha2::hash256_hex_string(data);
-        return hash.substr(0, 32); // 16 bytes (32 hex chars)
+        sha256::Digest hash = sha256::hash(data);
+        return sha256::toHex(hash.data(), 16); // 16 bytes (32 hex chars)
+    }
+
+    std::string User::generateID(IdStrategy strategy) const {
+        return strategy == IdStrategy::TimeOrdered ? UserId::timeOrdered().toHex() : generateID();
+    }
+
+    void User::generateIDs(std::vector<User>& users, IdStrategy strategy) {
+        std::vector<size_t> pending;
+        std::vector<std::string> data;
+        for (size_t i = 0; i < users.size(); ++i) {
+            if (!users[i].userID.empty()) continue;
+            pending.push_back(i);
+            data.push_back(users[i].name + users[i].email + users[i].dob + users[i].address);
+        }
+        std::vector<std::string_view> inputs(data.begin(), data.end());
+        std::vector<sha256::Digest> hashes(inputs.size());
+        sha256::hashMany(inputs.data(), inputs.size(), hashes.data());
+        if (strategy == IdStrategy::TimeOrdered) {
+            // Hand out the increasing IDs in content hash order, so a batch inserted in
+            // ID order also fills the content_hash index in order
+            std::vector<size_t> order(pending.size());
+            for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+            std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return hashes[a] < hashes[b]; });
+            for (size_t i : order) users[pending[i]].userID = UserId::timeOrdered().toHex();
+            return;
+        }
+        for (size_t i = 0; i < pending.size(); ++i)
+            users[pending[i]].userID = sha256::toHex(hashes[i].data(), 16);
     }
 
     bool User::updateInDB(Database& db) const {
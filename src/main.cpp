@@ -2,8 +2,14 @@
 #include <iostream>
 #include <algorithm>
 #include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include "../include/lms/Database.h"
 #include "../include/lms/Book.h"
+#include "../include/lms/Exporter.h"
+#include "../include/lms/Importer.h"
+#include "../include/lms/MappedCatalog.h"
 #include "../include/lms/User.h"
 using namespace lms;
 
@@ -16,23 +22,206 @@ std::string trim(const std::string& s) {
     return std::string(start, end + 1);
 }
 
+const int kPageSize = 20;
+
+// Asks whether to show the next page of a listing
+bool nextPage() {
+    std::cout << "-- Press Enter for more, or q to stop: ";
+    std::string line;
+    std::getline(std::cin, line);
+    return trim(line) != "q";
+}
+
 void listUsers(Database& db) {
-    auto users = db.getAllUsers();
+    std::cin.ignore(); // flush newline
     std::cout << "\nUsers in system:\n";
-    for (const auto& user : users) {
-        std::cout << "- " << user.getName() << " (" << user.getUserID() << ")\n";
+    std::string lastID;
+    while (true) {
+        auto users = db.listUsersAfter(lastID, kPageSize);
+        for (const auto& user : users) {
+            std::cout << "- " << user.getName() << " (" << user.getUserID() << ")\n";
+        }
+        if (users.size() < static_cast<size_t>(kPageSize) || !nextPage()) break;
+        lastID = users.back().getUserID();
     }
 }
 
 void listBooks(Database& db) {
-    auto books = db.getAllBooks();
+    std::cin.ignore(); // flush newline
     std::cout << "\nBooks in system:\n";
-    for (const auto& book : books) {
-        std::cout << "- " << book.getBookName() << " by " << book.getAuthor() << " (" << book.getBookID() << ")\n";
+    std::string lastID;
+    while (true) {
+        auto books = db.listBooksAfter(lastID, kPageSize);
+        for (const auto& book : books) {
+            std::cout << "- " << book.getBookName() << " by " << book.getAuthor() << " (" << book.getBookID() << ")\n";
+        }
+        if (books.size() < static_cast<size_t>(kPageSize) || !nextPage()) break;
+        lastID = books.back().getBookID();
+    }
+}
+
+void searchBooks(Database& db) {
+    std::cin.ignore(); // flush newline
+    std::string query;
+    std::cout << "Search title or author: ";
+    std::getline(std::cin, query);
+    auto results = db.searchBooks(trim(query), kPageSize);
+    if (results.empty()) {
+        std::cout << "No books found.\n";
+        return;
+    }
+    for (const auto& result : results) {
+        const Book& book = result.book;
+        std::cout << "- " << book.getBookName() << " by " << book.getAuthor() << " (" << book.getBookID() << ")\n"
+                  << "    " << result.snippet << "\n";
+    }
+}
+
+// lms import <books|users> <file> [--db path] [--format csv|jsonl] [--no-header] [--threads n] [--batch n]
+int runImport(int argc, char* argv[]) {
+    const char* usage = "Usage: lms import <books|users> <file> [--db path] [--format csv|jsonl] [--no-header] [--threads n] [--batch n] [--time-ids]\n";
+    if (argc < 4 || (std::strcmp(argv[2], "books") != 0 && std::strcmp(argv[2], "users") != 0)) {
+        std::cerr << usage;
+        return 1;
+    }
+    ImportOptions options;
+    options.kind = std::strcmp(argv[2], "books") == 0 ? ImportKind::Books : ImportKind::Users;
+    std::string path = argv[3];
+    std::string dbPath = "test.db";
+    // Default the format from the extension
+    size_t dot = path.find_last_of('.');
+    std::string extension = dot == std::string::npos ? "" : path.substr(dot);
+    if (extension == ".jsonl" || extension == ".ndjson" || extension == ".json")
+        options.format = ImportFormat::JsonLines;
+    for (int i = 4; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--db" && hasValue) {
+            dbPath = argv[++i];
+        } else if (arg == "--format" && hasValue) {
+            std::string format = argv[++i];
+            if (format != "csv" && format != "jsonl") {
+                std::cerr << usage;
+                return 1;
+            }
+            options.format = format == "csv" ? ImportFormat::Csv : ImportFormat::JsonLines;
+        } else if (arg == "--no-header") {
+            options.csvHeader = false;
+        } else if (arg == "--threads" && hasValue) {
+            options.parserThreads = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--batch" && hasValue) {
+            options.batchSize = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--time-ids") {
+            options.idStrategy = IdStrategy::TimeOrdered;
+        } else {
+            std::cerr << usage;
+            return 1;
+        }
+    }
+
+    Database db(dbPath);
+    if (!db.connect()) {
+        std::cerr << "Failed to connect to database!" << std::endl;
+        return 1;
     }
+    options.onProgress = [](const ImportProgress& progress) {
+        double percent = progress.totalBytes ? 100.0 * progress.bytesRead / progress.totalBytes : 100.0;
+        std::printf("\r%5.1f%%  %llu imported, %llu rejected, %llu malformed  %.1f MB/s, %.0f rows/s   ", percent,
+                    static_cast<unsigned long long>(progress.rowsInserted), static_cast<unsigned long long>(progress.rowsRejected),
+                    static_cast<unsigned long long>(progress.rowsMalformed), progress.megabytesPerSecond(), progress.rowsPerSecond());
+        std::fflush(stdout);
+    };
+    Importer importer(db, options);
+    bool ok = importer.run(path);
+    const ImportProgress& totals = importer.progress();
+    std::printf("\nImported %llu of %llu rows in %.1f s\n", static_cast<unsigned long long>(totals.rowsInserted),
+                static_cast<unsigned long long>(totals.rowsParsed + totals.rowsMalformed), totals.elapsedSeconds);
+    db.disconnect();
+    return ok ? 0 : 1;
 }
 
-int main() {
+// lms export <books|users> <file> [--db path] [--format csv|jsonl|columnar]
+int runExport(int argc, char* argv[]) {
+    const char* usage = "Usage: lms export <books|users> <file> [--db path] [--format csv|jsonl|columnar]\n";
+    if (argc < 4 || (std::strcmp(argv[2], "books") != 0 && std::strcmp(argv[2], "users") != 0)) {
+        std::cerr << usage;
+        return 1;
+    }
+    bool books = std::strcmp(argv[2], "books") == 0;
+    std::string path = argv[3];
+    std::string dbPath = "test.db";
+    ExportOptions options;
+    // Default the format from the extension
+    size_t dot = path.find_last_of('.');
+    std::string extension = dot == std::string::npos ? "" : path.substr(dot);
+    if (extension == ".jsonl" || extension == ".ndjson" || extension == ".json")
+        options.format = ExportFormat::JsonLines;
+    else if (extension == ".lmsc")
+        options.format = ExportFormat::Columnar;
+    for (int i = 4; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--db" && hasValue) {
+            dbPath = argv[++i];
+        } else if (arg == "--format" && hasValue) {
+            std::string format = argv[++i];
+            if (format == "csv") options.format = ExportFormat::Csv;
+            else if (format == "jsonl") options.format = ExportFormat::JsonLines;
+            else if (format == "columnar") options.format = ExportFormat::Columnar;
+            else {
+                std::cerr << usage;
+                return 1;
+            }
+        } else {
+            std::cerr << usage;
+            return 1;
+        }
+    }
+
+    Database db(dbPath);
+    if (!db.connect()) {
+        std::cerr << "Failed to connect to database!" << std::endl;
+        return 1;
+    }
+    Exporter exporter(db, options);
+    bool ok = books ? exporter.exportBooks(path) : exporter.exportUsers(path);
+    const ExportStats& stats = exporter.stats();
+    std::printf("Exported %llu rows (%.1f MB) in %.2f s, %.1f MB/s\n", static_cast<unsigned long long>(stats.rows),
+                stats.bytes / (1024.0 * 1024.0), stats.elapsedSeconds, stats.megabytesPerSecond());
+    db.disconnect();
+    return ok ? 0 : 1;
+}
+
+// lms snapshot <file> [--db path]
+int runSnapshot(int argc, char* argv[]) {
+    std::string dbPath = "test.db";
+    if (argc == 5 && std::strcmp(argv[3], "--db") == 0) {
+        dbPath = argv[4];
+    } else if (argc != 3) {
+        std::cerr << "Usage: lms snapshot <file> [--db path]\n";
+        return 1;
+    }
+    Database db(dbPath);
+    if (!db.connect()) {
+        std::cerr << "Failed to connect to database!" << std::endl;
+        return 1;
+    }
+    bool ok = MappedCatalog::write(db, argv[2]);
+    db.disconnect();
+    if (ok) std::cout << "Catalog snapshot written to " << argv[2] << "\n";
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::strcmp(argv[1], "import") == 0) {
+        return runImport(argc, argv);
+    }
+    if (argc > 1 && std::strcmp(argv[1], "export") == 0) {
+        return runExport(argc, argv);
+    }
+    if (argc > 1 && std::strcmp(argv[1], "snapshot") == 0) {
+        return runSnapshot(argc, argv);
+    }
     Database db("test.db");
     if (!db.connect()) {
         std::cerr << "Failed to connect to database!" << std::endl;
@@ -41,11 +230,12 @@ int main() {
     std::cout << "Library Management System Started!\n";
     int choice;
     do {
-        std::cout << "\nMenu:\n1. List Users\n2. List Books\n3. Add User\n4. Add Book\n0. Exit\nChoice: ";
+        std::cout << "\nMenu:\n1. List Users\n2. List Books\n3. Add User\n4. Add Book\n5. Search Books\n0. Exit\nChoice: ";
         std::cin >> choice;
         switch (choice) {
             case 1: listUsers(db); break;
             case 2: listBooks(db); break;
+            case 5: searchBooks(db); break;
             case 3: {
                 std::cin.ignore(); // flush newline
                 std::string name, email, dob, address;
@@ -0,0 +1,104 @@
+// Checks that addBook, updateBook and updateUser allocate the same number of times
+// whether a book has 1 tag or 100, and a user's fields are 100 times longer: every
+// column is bound in place, so the cost of a write must not grow with the row.
+#include "lms/Database.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace lms;
+
+static std::atomic<long> allocations{0};
+
+void* operator new(size_t size) {
+    ++allocations;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+    struct Counts {
+        long addBook = 0;
+        long updateBook = 0;
+        long updateUser = 0;
+    };
+
+    template <typename Fn>
+    long countAllocations(Fn fn) {
+        long before = allocations.load();
+        fn();
+        return allocations.load() - before;
+    }
+
+    Book makeBook(const std::string& name, size_t tagCount) {
+        Book book(name, "Author", "2000");
+        std::vector<std::string> tags;
+        for (size_t i = 0; i < tagCount; ++i) tags.push_back("tag" + std::to_string(i));
+        book.setTags(tags);
+        book.setBookID(book.generateID());
+        return book;
+    }
+
+    bool measure(Database& db, size_t size, Counts& counts) {
+        std::string suffix = std::to_string(size);
+        Book book = makeBook("Stored " + suffix, size);
+        if (!db.addBook(book)) return false;
+        Book added = makeBook("Added " + suffix, size);
+
+        // Users carry no tags; the text updateUser binds grows with size instead. The
+        // user is built in memory, so every field is dirty and every column written.
+        std::string address;
+        for (size_t i = 0; i < size; ++i) address += std::to_string(i) + " Main Street, ";
+        User user("User " + suffix + std::string(16 * size, 'n'), "user" + suffix + "@example.com", "2000-01-01", address);
+        user.setUserID(user.generateID());
+        if (!db.addUser(user)) return false;
+        user.setName(user.getName() + " Jr.");
+        user.setAddress(user.getAddress() + "Springfield");
+
+        bool ok = true;
+        counts.updateBook = countAllocations([&] { ok &= db.updateBook(book); });
+        counts.addBook = countAllocations([&] { ok &= db.addBook(added); });
+        counts.updateUser = countAllocations([&] { ok &= db.updateUser(user); });
+        return ok;
+    }
+}
+
+int main() {
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "lms_test_allocations.db";
+    for (const char* suffix : {"", "-wal", "-shm"}) std::filesystem::remove(path.string() + suffix);
+
+    int failures = 0;
+    {
+        Database db(path.string());
+        if (!db.connect()) {
+            std::fprintf(stderr, "cannot open %s\n", path.string().c_str());
+            return 1;
+        }
+
+        // Prepare every statement first so the measured calls only run them
+        Counts warm, one, hundred;
+        if (!measure(db, 10, warm) || !measure(db, 1, one) || !measure(db, 100, hundred)) {
+            std::fprintf(stderr, "database write failed\n");
+            return 1;
+        }
+
+        auto check = [&](const char* name, long a, long b) {
+            std::printf("%-10s size 1: %ld allocations, size 100: %ld\n", name, a, b);
+            if (a != b) {
+                std::fprintf(stderr, "FAIL: %s allocates %ld times at size 1 but %ld at size 100\n", name, a, b);
+                ++failures;
+            }
+        };
+        check("addBook", one.addBook, hundred.addBook);
+        check("updateBook", one.updateBook, hundred.updateBook);
+        check("updateUser", one.updateUser, hundred.updateUser);
+    }
+    for (const char* suffix : {"", "-wal", "-shm"}) std::filesystem::remove(path.string() + suffix);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+// Round-trips books through CompactBook, and checks that the object cache keeps
+// books whose IDs are too long for it out instead of truncating them, that it does
+// not remember misses, and that its string pool stays bounded.
+#include "lms/CompactBook.h"
+#include "lms/Database.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+using namespace lms;
+
+namespace {
+    int failures = 0;
+
+    void check(bool condition, const char* what) {
+        if (!condition) {
+            std::fprintf(stderr, "FAIL: %s\n", what);
+            ++failures;
+        }
+    }
+
+    bool same(const Book& a, const Book& b) {
+        return a.getBookID() == b.getBookID() && a.getBookName() == b.getBookName() &&
+               a.getAuthor() == b.getAuthor() && a.getPublicationYear() == b.getPublicationYear() &&
+               a.getCurrentUser() == b.getCurrentUser() && a.getTags() == b.getTags() &&
+               a.available() == b.available();
+    }
+
+    bool roundTrips(const Book& book, StringPool& pool) {
+        CompactBook compact(book, pool);
+        CompactBook copy = compact;
+        return same(compact.toBook(pool), book) && same(copy.toBook(pool), book) &&
+               compact.toBook(pool).dirtyFields() == 0;
+    }
+}
+
+int main() {
+    StringPool pool;
+    Book book("A fairly long book name", "Author", "1999");
+    book.setID(BookId::timeOrdered());
+    check(roundTrips(book, pool), "canonical IDs");
+    book.setCurrentUser(UserId::timeOrdered().toHex());
+    book.setAvailable(false);
+    for (int i = 0; i < 9; ++i) book.addTag("tag" + std::to_string(i % 5));
+    check(roundTrips(book, pool), "canonical borrower and spilled tags");
+    book.setBookID("custom-id");
+    book.setCurrentUser("custom-user");
+    check(roundTrips(book, pool), "custom IDs");
+    check(roundTrips(Book(), pool), "empty book");
+
+    Book longBorrower = book;
+    longBorrower.setCurrentUser(std::string(70000, 'u'));
+    check(!CompactBook::fits(longBorrower), "fits() rejects a 70000-byte borrower ID");
+    longBorrower.setCurrentUser(std::string(65535, 'u'));
+    check(CompactBook::fits(longBorrower) && roundTrips(longBorrower, pool), "65535-byte borrower ID");
+
+    // Through the cache: a book lent to a user with a very long custom ID is read
+    // back whole, from the database each time
+    std::string path = (std::filesystem::temp_directory_path() / "lms_test_compact_book.db").string();
+    for (const char* suffix : {"", "-wal", "-shm"}) std::filesystem::remove(path + suffix);
+    {
+        Database db(path);
+        check(db.connect(), "connect");
+        db.enableObjectCache(100, 100);
+        User user("Long", "long@example.com");
+        user.setUserID(std::string(70000, 'x'));
+        Book lent("Lent", "Author", "2001");
+        lent.setID(BookId::timeOrdered());
+        check(db.addUser(user) && db.addBook(lent), "insert");
+        check(db.borrowBook(user.getUserID(), lent.getBookID()) == LoanStatus::Success, "borrow");
+        for (int i = 0; i < 3; ++i)
+            check(db.getBook(lent.getID()).getCurrentUser() == user.getUserID(), "long borrower ID read back whole");
+    }
+    for (const char* suffix : {"", "-wal", "-shm"}) std::filesystem::remove(path + suffix);
+
+    // A lookup that found nothing must not be cached: rows added through another
+    // connection invalidate nothing here, so a cached miss would hide them
+    {
+        Database db(path);
+        check(db.connect(), "connect");
+        db.enableObjectCache(100, 100);
+        Book book("Later", "Author", "2002");
+        book.setID(BookId::timeOrdered());
+        User user("Later", "later@example.com");
+        user.setID(UserId::timeOrdered());
+        check(db.getBook(book.getID()).getBookID().empty() && db.getUser(user.getID()).getUserID().empty(), "not there yet");
+        {
+            Database other(path);
+            check(other.connect() && other.addBook(book) && other.addUser(user), "insert through another connection");
+        }
+        check(db.getBook(book.getID()).getBookID() == book.getBookID(), "book found after a miss");
+        check(db.getUser(user.getID()).getUserID() == user.getUserID(), "user found after a miss");
+    }
+    for (const char* suffix : {"", "-wal", "-shm"}) std::filesystem::remove(path + suffix);
+
+    // Reading many more distinct books than the cache holds must not grow its string
+    // pool without bound, and books that stay cached across pool rebuilds must still
+    // read back whole
+    {
+        Database db(path);
+        check(db.connect(), "connect");
+        db.enableObjectCache(100, 0);
+        std::vector<Book> books;
+        for (int i = 0; i < 5000; ++i) {
+            Book book("Book " + std::to_string(i), "Author " + std::to_string(i), std::to_string(1000 + i));
+            for (int t = 0; t < 3; ++t) book.addTag("tag " + std::to_string(i) + "-" + std::to_string(t));
+            book.setBookID(book.generateID());
+            books.push_back(book);
+        }
+        db.addBooks(books);
+        bool intact = true;
+        size_t peak = 0;
+        for (size_t i = 0; i < books.size(); ++i) {
+            intact &= same(db.getBook(books[i].getID()), books[i]);
+            intact &= same(db.getBook(books[i % 20].getID()), books[i % 20]);    // Kept hot
+            peak = std::max(peak, db.bookCacheStats().sharedBytes);
+        }
+        check(intact, "books read through the cache across pool rebuilds");
+        check(peak < 1024 * 1024, "book cache string pool stays bounded");
+    }
+    for (const char* suffix : {"", "-wal", "-shm"}) std::filesystem::remove(path + suffix);
+    return failures == 0 ? 0 : 1;
+}
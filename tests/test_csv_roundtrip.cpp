@@ -0,0 +1,64 @@
+// Checks that tags survive a CSV export and import unchanged, including tags that
+// contain the CSV field separator, the tag separator ';', quotes or backslashes.
+#include "lms/Database.h"
+#include "lms/Exporter.h"
+#include "lms/Importer.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+using namespace lms;
+
+namespace {
+    int failures = 0;
+
+    void check(bool condition, const char* what) {
+        if (!condition) {
+            std::fprintf(stderr, "FAIL: %s\n", what);
+            ++failures;
+        }
+    }
+
+    void removeDatabase(const std::string& path) {
+        for (const char* suffix : {"", "-wal", "-shm"}) std::filesystem::remove(path + suffix);
+    }
+}
+
+int main() {
+    auto dir = std::filesystem::temp_directory_path();
+    std::string source = (dir / "lms_test_csv_source.db").string();
+    std::string target = (dir / "lms_test_csv_target.db").string();
+    std::string csv = (dir / "lms_test_csv_roundtrip.csv").string();
+    removeDatabase(source);
+    removeDatabase(target);
+
+    const std::vector<std::string> tags = {"a,b", "c;d", "say \"hi\"", "back\\slash", "end\\", "plain"};
+    Book book("Tagged", "Author", "2000");
+    book.setBookID(book.generateID());
+    book.setTags(tags);
+    {
+        Database db(source);
+        check(db.connect(), "connect source");
+        check(db.addBook(book), "addBook");
+        check(Exporter(db).exportBooks(csv), "exportBooks");
+    }
+    {
+        Database db(target);
+        check(db.connect(), "connect target");
+        ImportOptions options;
+        options.kind = ImportKind::Books;
+        options.format = ImportFormat::Csv;
+        Importer importer(db, options);
+        check(importer.run(csv), "import");
+        std::vector<std::string> expected = tags, imported = db.getBook(book.getBookID()).getTags();
+        std::sort(expected.begin(), expected.end());
+        std::sort(imported.begin(), imported.end());
+        check(imported == expected, "tags read back unchanged");
+    }
+    removeDatabase(source);
+    removeDatabase(target);
+    std::filesystem::remove(csv);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,195 @@
+// Checks RoaringBitmap against std::set with both the portable and (where the CPU
+// has it) the AVX2 kernels, the TagQuery parser, and tag queries through Database
+// with and without the tag index.
+#include "lms/Database.h"
+#include "lms/TagIndex.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <iterator>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace lms;
+
+namespace {
+    int failures = 0;
+
+    void check(bool condition, const std::string& what) {
+        if (!condition) {
+            std::fprintf(stderr, "FAIL: %s\n", what.c_str());
+            ++failures;
+        }
+    }
+
+    std::vector<uint32_t> toVector(const std::set<uint32_t>& values) {
+        return std::vector<uint32_t>(values.begin(), values.end());
+    }
+
+    // Random sets from sparse (array containers) to dense (bitmap containers), in
+    // every pairing, so each operation meets each container combination
+    void checkAgainstSet(const char* kernels) {
+        std::mt19937 rng(7);
+        for (int round = 0; round < 36; ++round) {
+            RoaringBitmap a, b;
+            std::set<uint32_t> expectedA, expectedB;
+            auto fill = [&](RoaringBitmap& bitmap, std::set<uint32_t>& expected, int density) {
+                int count = density == 0 ? 100 : density == 1 ? 20000 : 70000;
+                uint32_t span = density == 2 ? 300000 : 1u << 22;
+                for (int i = 0; i < count; ++i) {
+                    uint32_t value = rng() % span;
+                    bitmap.add(value);
+                    expected.insert(value);
+                }
+            };
+            fill(a, expectedA, round % 3);
+            fill(b, expectedB, (round / 3) % 3);
+            for (int i = 0; i < 500; ++i) {
+                uint32_t value = rng() % 300000;
+                bool present = expectedA.erase(value) > 0;
+                check(a.remove(value) == present, "remove reports membership");
+            }
+
+            std::string context = std::string(kernels) + " round " + std::to_string(round) + ": ";
+            check(a.toVector() == toVector(expectedA), context + "contents");
+            check(a.cardinality() == expectedA.size(), context + "cardinality");
+            std::set<uint32_t> expected;
+            std::set_intersection(expectedA.begin(), expectedA.end(), expectedB.begin(), expectedB.end(),
+                                  std::inserter(expected, expected.end()));
+            check((a & b).toVector() == toVector(expected), context + "a & b");
+            expected.clear();
+            std::set_union(expectedA.begin(), expectedA.end(), expectedB.begin(), expectedB.end(),
+                           std::inserter(expected, expected.end()));
+            check((a | b).toVector() == toVector(expected), context + "a | b");
+            expected.clear();
+            std::set_difference(expectedA.begin(), expectedA.end(), expectedB.begin(), expectedB.end(),
+                                std::inserter(expected, expected.end()));
+            check((a - b).toVector() == toVector(expected), context + "a - b");
+            check((a & b).cardinality() + (a - b).cardinality() == a.cardinality(), context + "cardinalities add up");
+
+            RoaringBitmap c = a;
+            c &= b;
+            c |= a;
+            check(c == a, context + "(a & b) | a == a");
+            c -= a;
+            check(c.empty(), context + "a - a is empty");
+            for (int i = 0; i < 1000; ++i) {
+                uint32_t value = rng() % 300000;
+                check(a.contains(value) == (expectedA.count(value) > 0), context + "contains");
+            }
+        }
+
+        // A bitmap container shrinking back into an array
+        RoaringBitmap shrinking;
+        for (uint32_t i = 0; i < 10000; ++i) shrinking.add(i);
+        for (uint32_t i = 0; i < 9000; ++i) shrinking.remove(i);
+        check(shrinking.cardinality() == 1000 && shrinking.contains(9999) && !shrinking.contains(5),
+              std::string(kernels) + ": bitmap back to array");
+    }
+
+    void checkParser() {
+        const std::string sep(1, kTagSeparator);
+        TagQuery query;
+        check(TagQuery::parse("fantasy AND young-adult NOT horror", query) &&
+              query.matches("fantasy" + sep + "young-adult") &&
+              !query.matches("fantasy" + sep + "young-adult" + sep + "horror") && !query.matches("fantasy"),
+              "AND / NOT");
+        check(TagQuery::parse("NOT a", query) && query.matches("b") && !query.matches("a") && query.matches(""),
+              "leading NOT");
+        check(TagQuery::parse("(a OR b) c", query) && query.matches("b" + sep + "c") && !query.matches("b"),
+              "parentheses and implicit AND");
+        check(TagQuery::parse("a OR b c", query) && query.matches("a") && !query.matches("b"), "AND binds tighter");
+        check(TagQuery::parse("\"science fiction\" OR \"AND\"", query) && query.matches("AND") &&
+              query.matches("science fiction"), "quoted tags");
+        for (const char* invalid : {"", "a AND", "(a", "a)", "\"a", "OR a"}) {
+            std::string error;
+            check(!TagQuery::parse(invalid, query, &error) && !error.empty(),
+                  std::string("rejects \"") + invalid + "\"");
+        }
+    }
+
+    // The all-zero ID is canonical but is also the marker for custom IDs
+    void checkNullId() {
+        const std::string zero(BookId::kHexLength, '0');
+        TagIndex index;
+        index.setBook(zero, "a");
+        index.setBook("custom", "a");
+        TagQuery query;
+        TagQuery::parse("a", query);
+        check(index.findBooks(query) == (std::vector<std::string>{zero, "custom"}), "all-zero ID is returned");
+        index.removeBook(zero);
+        check(index.findBooks(query) == std::vector<std::string>{"custom"}, "all-zero ID is removed");
+    }
+
+    // Database answers must not depend on whether the tag index is enabled
+    void checkDatabase() {
+        std::string path = (std::filesystem::temp_directory_path() / "lms_test_roaring.db").string();
+        for (const char* suffix : {"", "-wal", "-shm"}) std::filesystem::remove(path + suffix);
+        {
+            Database indexed(path), scanned(path);
+            check(indexed.connect() && scanned.connect(), "connect");
+            std::vector<Book> books;
+            // More books than one batched fetch reads, with some custom IDs among them
+            for (int i = 0; i < 1200; ++i) {
+                Book book("Book " + std::to_string(i), "Author", "2000");
+                for (int t = 0; t < 5; ++t)
+                    if (i % (t + 2) == 0) book.addTag("tag" + std::to_string(t));
+                book.setBookID(i % 100 == 0 ? "custom-" + std::to_string(i) : book.generateID());
+                books.push_back(book);
+            }
+            indexed.addBooks(books);
+            check(indexed.enableTagIndex(), "enableTagIndex");
+
+            auto same = [&](const std::string& query) {
+                auto a = indexed.findBooksByTagQuery(query), b = scanned.findBooksByTagQuery(query);
+                bool equal = a.size() == b.size() && indexed.countBooksByTagQuery(query) == b.size() &&
+                             scanned.countBooksByTagQuery(query) == b.size();
+                auto ids = indexed.findBookIDsByTagQuery(query);
+                equal = equal && ids.size() == a.size();
+                for (size_t i = 0; equal && i < a.size(); ++i)
+                    equal = a[i].getBookID() == b[i].getBookID() && a[i].getBookID() == ids[i] &&
+                            a[i].getTags() == b[i].getTags();
+                equal = equal && std::is_sorted(ids.begin(), ids.end());
+                auto limited = indexed.findBooksByTagQuery(query, 5);
+                equal = equal && limited.size() == std::min<size_t>(5, b.size());
+                for (size_t i = 0; equal && i < limited.size(); ++i) equal = limited[i].getBookID() == b[i].getBookID();
+                check(equal, "index and scan agree on \"" + query + "\"");
+            };
+            std::vector<std::string> queries = {"tag0", "tag1 OR tag2", "tag0 NOT tag3", "NOT tag0", "nosuch",
+                                                "(tag1 OR tag2) AND NOT tag3 OR tag4"};
+            for (const auto& query : queries) same(query);
+
+            // Writes through the indexed Database keep its index current
+            Book added("New", "Someone", "2020");
+            added.addTag("tag3");
+            added.addTag("fresh");
+            added.setBookID("custom-new");
+            check(indexed.addBook(added), "addBook");
+            Book changed = books[10];
+            changed.setTags({"fresh", "tag0"});
+            check(indexed.updateBook(changed), "updateBook");
+            check(indexed.removeBook(books[20].getBookID()), "removeBook");
+            queries.push_back("fresh");
+            queries.push_back("fresh NOT tag0");
+            for (const auto& query : queries) same(query);
+            check(indexed.countBooksByTagQuery("fresh") == 2, "count after writes");
+            check(indexed.findBooksByTagQuery("a AND").empty(), "invalid query matches nothing");
+        }
+        for (const char* suffix : {"", "-wal", "-shm"}) std::filesystem::remove(path + suffix);
+    }
+}
+
+int main() {
+    bool simd = RoaringBitmap::usingSimd();
+    RoaringBitmap::useSimd(false);
+    checkAgainstSet("portable");
+    if (RoaringBitmap::useSimd(true)) checkAgainstSet("avx2");
+    else std::printf("AVX2 kernels unavailable, checked the portable ones only\n");
+    RoaringBitmap::useSimd(simd);
+    checkParser();
+    checkNullId();
+    checkDatabase();
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,87 @@
+// Checks that full-text search stays in step with the books table across VACUUM,
+// which may renumber implicit rowids; books_fts must be keyed on a stable column.
+#include "lms/Database.h"
+#include <sqlite3.h>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+using namespace lms;
+
+namespace {
+    int failures = 0;
+
+    void check(bool condition, const char* what) {
+        if (!condition) {
+            std::fprintf(stderr, "FAIL: %s\n", what);
+            ++failures;
+        }
+    }
+
+    // True if books has an INTEGER PRIMARY KEY column, whose values VACUUM keeps
+    bool hasStableRowids(const std::string& path) {
+        sqlite3* db = nullptr;
+        sqlite3_stmt* stmt = nullptr;
+        bool found = sqlite3_open(path.c_str(), &db) == SQLITE_OK &&
+                     sqlite3_prepare_v2(db, "SELECT count(*) FROM pragma_table_info('books') "
+                                            "WHERE pk = 1 AND upper(type) = 'INTEGER';", -1, &stmt, nullptr) == SQLITE_OK &&
+                     sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int(stmt, 0) == 1;
+        sqlite3_finalize(stmt);
+        sqlite3_close(db);
+        return found;
+    }
+
+    bool vacuum(const std::string& path) {
+        sqlite3* db = nullptr;
+        bool ok = sqlite3_open(path.c_str(), &db) == SQLITE_OK &&
+                  sqlite3_exec(db, "VACUUM;", nullptr, nullptr, nullptr) == SQLITE_OK;
+        sqlite3_close(db);
+        return ok;
+    }
+
+    // IDs of the books searchBooks returns for query
+    std::vector<std::string> search(const Database& db, const std::string& query) {
+        std::vector<std::string> ids;
+        for (const auto& result : db.searchBooks(query)) ids.push_back(result.book.getBookID());
+        return ids;
+    }
+}
+
+int main() {
+    std::string path = (std::filesystem::temp_directory_path() / "lms_test_search.db").string();
+    for (const char* suffix : {"", "-wal", "-shm"}) std::filesystem::remove(path + suffix);
+
+    std::vector<Book> books;
+    for (const char* title : {"Alpha Centauri", "Bravo Two Zero", "Charlie Chaplin", "Delta Blues"}) {
+        Book book(title, "Author", "2000");
+        book.setBookID(book.generateID());
+        books.push_back(book);
+    }
+    {
+        Database db(path);
+        check(db.connect(), "connect");
+        for (const Book& book : books) check(db.addBook(book), "addBook");
+        // Leave gaps in the rowids for VACUUM to close
+        check(db.removeBook(books[0].getBookID()) && db.removeBook(books[1].getBookID()), "removeBook");
+    }
+    check(hasStableRowids(path), "books_fts is keyed on an INTEGER PRIMARY KEY");
+    check(vacuum(path), "VACUUM");
+    {
+        Database db(path);
+        check(db.connect(), "reconnect");
+        check(search(db, "charlie") == std::vector<std::string>{books[2].getBookID()}, "search finds the right book");
+        check(search(db, "delta") == std::vector<std::string>{books[3].getBookID()}, "search finds the other book");
+
+        // The update trigger must remove the old title from the index, not another row's
+        Book renamed = db.getBook(books[2].getBookID());
+        renamed.setBookName("Echo Chamber");
+        check(db.updateBook(renamed), "updateBook");
+        check(search(db, "charlie").empty(), "old title is gone");
+        check(search(db, "echo") == std::vector<std::string>{books[2].getBookID()}, "new title is found");
+        check(search(db, "delta") == std::vector<std::string>{books[3].getBookID()}, "other book unaffected");
+        check(db.removeBook(books[3].getBookID()) && search(db, "delta").empty(), "delete removes the index entry");
+    }
+    for (const char* suffix : {"", "-wal", "-shm"}) std::filesystem::remove(path + suffix);
+    return failures == 0 ? 0 : 1;
+}
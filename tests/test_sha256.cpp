@@ -0,0 +1,53 @@
+// Checks every SHA-256 backend this CPU supports against picosha2, for messages
+// of every length across the block and padding boundaries and for batches that
+// exercise the multi-buffer path.
+#include "lms/Sha256.h"
+#include "picosha2.h"
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace lms;
+
+int main() {
+    std::mt19937 rng(1);
+    std::vector<std::string> inputs;
+    for (size_t length = 0; length < 300; ++length) {
+        std::string message(length, '\0');
+        for (char& c : message) c = static_cast<char>(rng());
+        inputs.push_back(message);
+    }
+    for (int i = 0; i < 5000; ++i) {
+        std::string message(20 + rng() % 60, 'a');
+        for (char& c : message) c = static_cast<char>('a' + rng() % 26);
+        inputs.push_back(message);
+    }
+    std::vector<std::string> expected;
+    for (const std::string& message : inputs) expected.push_back(picosha2::hash256_hex_string(message));
+    std::vector<std::string_view> views(inputs.begin(), inputs.end());
+
+    const sha256::Backend backends[] = {sha256::Backend::Portable, sha256::Backend::ShaNi, sha256::Backend::Avx2};
+    int failures = 0, tested = 0;
+    for (sha256::Backend single : backends) {
+        for (sha256::Backend batch : backends) {
+            if (!sha256::useBackends(single, batch)) continue;
+            ++tested;
+            std::vector<sha256::Digest> digests(views.size());
+            sha256::hashMany(views.data(), views.size(), digests.data());
+            for (size_t i = 0; i < views.size(); ++i) {
+                if (sha256::toHex(digests[i].data(), digests[i].size()) != expected[i]) {
+                    std::fprintf(stderr, "FAIL: batch %s, message %zu\n", sha256::backendName(batch), i);
+                    ++failures;
+                }
+                sha256::Digest digest = sha256::hash(views[i]);
+                if (sha256::toHex(digest.data(), digest.size()) != expected[i]) {
+                    std::fprintf(stderr, "FAIL: single %s, message %zu\n", sha256::backendName(single), i);
+                    ++failures;
+                }
+            }
+        }
+    }
+    std::printf("%d backend combinations checked against picosha2\n", tested);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,80 @@
+// Checks that partial updates keep content_hash in step with the stored row, even
+// when the caller's copy holds stale values in the fields it did not change.
+#include "lms/Database.h"
+#include <sqlite3.h>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+using namespace lms;
+
+namespace {
+    int failures = 0;
+
+    void check(bool condition, const char* what) {
+        if (!condition) {
+            std::fprintf(stderr, "FAIL: %s\n", what);
+            ++failures;
+        }
+    }
+
+    // lower(hex(content_hash)) of the row with the given canonical ID
+    std::string storedHash(const std::string& path, const char* table, const std::string& id) {
+        sqlite3* db = nullptr;
+        sqlite3_stmt* stmt = nullptr;
+        std::string hash;
+        std::string sql = std::string("SELECT lower(hex(content_hash)) FROM ") + table + " WHERE lower(hex(id)) = ?;";
+        if (sqlite3_open(path.c_str(), &db) == SQLITE_OK &&
+            sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
+            sqlite3_bind_text(stmt, 1, id.c_str(), -1, SQLITE_TRANSIENT);
+            if (sqlite3_step(stmt) == SQLITE_ROW)
+                if (const unsigned char* text = sqlite3_column_text(stmt, 0)) hash = reinterpret_cast<const char*>(text);
+        }
+        sqlite3_finalize(stmt);
+        sqlite3_close(db);
+        return hash;
+    }
+}
+
+int main() {
+    std::string path = (std::filesystem::temp_directory_path() / "lms_test_updates.db").string();
+    for (const char* suffix : {"", "-wal", "-shm"}) std::filesystem::remove(path + suffix);
+    {
+        Database db(path);
+        check(db.connect(), "connect");
+
+        Book book("Original Title", "Author", "2000");
+        book.setBookID(book.generateID());
+        check(db.addBook(book), "addBook");
+        // Two readers load the book; one renames it, the other then changes only the author
+        Book first = db.getBook(book.getBookID()), second = db.getBook(book.getBookID());
+        first.setBookName("New Title");
+        check(db.updateBook(first), "rename");
+        second.setAuthor("Someone Else");
+        check(db.updateBook(second), "change author from a stale copy");
+        Book stored = db.getBook(book.getBookID());
+        check(stored.getBookName() == "New Title" && stored.getAuthor() == "Someone Else", "both changes stored");
+        Book expected(stored.getBookName(), stored.getAuthor(), stored.getPublicationYear());
+        check(storedHash(path, "books", book.getBookID()) == expected.generateID(), "book hash matches the row");
+        // The hash must catch an exact copy of the stored row
+        Book copy(stored.getBookName(), stored.getAuthor(), stored.getPublicationYear());
+        copy.setBookID("copy");
+        check(!db.addBook(copy), "copy of the stored row is refused");
+
+        User user("Reader", "reader@example.com", "1990-01-01", "1 Main Street");
+        user.setUserID(user.generateID());
+        check(db.addUser(user), "addUser");
+        User userA = db.getUser(user.getUserID()), userB = db.getUser(user.getUserID());
+        userA.setEmail("new@example.com");
+        check(db.updateUser(userA), "change email");
+        userB.setAddress("2 High Street");
+        check(db.updateUser(userB), "change address from a stale copy");
+        User storedUser = db.getUser(user.getUserID());
+        User expectedUser(storedUser.getName(), storedUser.getEmail(), storedUser.getDOB(), storedUser.getAddress());
+        check(storedUser.getEmail() == "new@example.com" && storedUser.getAddress() == "2 High Street",
+              "both user changes stored");
+        check(storedHash(path, "users", user.getUserID()) == expectedUser.generateID(), "user hash matches the row");
+    }
+    for (const char* suffix : {"", "-wal", "-shm"}) std::filesystem::remove(path + suffix);
+    return failures == 0 ? 0 : 1;
+}
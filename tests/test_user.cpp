@@ -0,0 +1,73 @@
+// Checks User's borrowed list, held as BookIds with a text fallback for custom
+// IDs, in memory and as read back from the loans table.
+#include "lms/Database.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+using namespace lms;
+
+namespace {
+    int failures = 0;
+
+    void check(bool condition, const char* what) {
+        if (!condition) {
+            std::fprintf(stderr, "FAIL: %s\n", what);
+            ++failures;
+        }
+    }
+
+    std::vector<std::string> sorted(std::vector<std::string> ids) {
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    }
+}
+
+int main() {
+    const std::string canonical = BookId::timeOrdered().toHex();
+    const std::string custom = "custom-book";
+
+    User user("Reader", "reader@example.com");
+    user.addBorrowedBook(canonical);
+    user.addBorrowedBook(custom);
+    user.addBorrowedBook(canonical);
+    check(user.borrowedCount() == 2, "duplicates are ignored");
+    check(user.getBorrowedBookIDs().size() == 1 && user.getBorrowedBookIDs()[0].toHex() == canonical,
+          "canonical IDs are stored as BookIds");
+    check(user.getCustomBorrowedBooks() == std::vector<std::string>{custom}, "custom IDs are kept as text");
+    check(user.getBorrowedBooks() == (std::vector<std::string>{canonical, custom}), "text list, canonical first");
+    check(user.hasBorrowed(canonical) && user.hasBorrowed(custom) && !user.hasBorrowed("other"), "hasBorrowed");
+    user.removeBorrowedBook(canonical);
+    user.removeBorrowedBook(custom);
+    check(user.borrowedCount() == 0, "removeBorrowedBook");
+    user.setBorrowedBooks(std::vector<std::string>{custom, canonical});
+    check(user.getBorrowedBookIDs().size() == 1 && user.getCustomBorrowedBooks().size() == 1, "setBorrowedBooks");
+
+    std::string path = (std::filesystem::temp_directory_path() / "lms_test_user.db").string();
+    for (const char* suffix : {"", "-wal", "-shm"}) std::filesystem::remove(path + suffix);
+    {
+        Database db(path);
+        check(db.connect(), "connect");
+        User reader("Reader", "reader@example.com");
+        reader.setUserID(reader.generateID());
+        check(db.addUser(reader), "addUser");
+        std::vector<std::string> lent;
+        for (int i = 0; i < 3; ++i) {
+            Book book("Book " + std::to_string(i), "Author", "2000");
+            book.setBookID(i == 2 ? custom : book.generateID());
+            check(db.addBook(book), "addBook");
+            check(reader.borrowBookDB(book.getBookID(), db), "borrowBookDB");
+            lent.push_back(book.getBookID());
+        }
+        User loaded = db.getUser(reader.getUserID());
+        check(loaded.getBorrowedBookIDs().size() == 2 && loaded.getCustomBorrowedBooks().size() == 1,
+              "loans read back split by kind");
+        check(sorted(loaded.getBorrowedBooks()) == sorted(lent), "loans read back");
+        check(loaded.returnBookDB(custom, db) && !loaded.hasBorrowed(custom), "returnBookDB");
+        check(db.getUser(reader.getUserID()).borrowedCount() == 2, "return is stored");
+    }
+    for (const char* suffix : {"", "-wal", "-shm"}) std::filesystem::remove(path + suffix);
+    return failures == 0 ? 0 : 1;
+}